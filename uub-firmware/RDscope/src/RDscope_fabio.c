@@ -12,65 +12,79 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 
 //#include "fe_lib.h" /*this include automatically the shwr_evt_defs.h */
 //#include "fe_kernel_interface_defs.h"
-//#include "read_evt.h"
+#include "read_evt.h"
 #include "shwr_evt_defs.h"
 
 #include "xparameters.h"
 #include "sde_trigger_defs.h"
 #include "time_tagging.h"
+#include "evt_wait.h"
+#include "evt_file.h"
+#include "evt_queue.h"
+#include "evt_stats.h"
+#include "mem_copy.h"
+#include "trig_mon.h"
+#include "ttag_cal.h"
+#include "evt_pub.h"
+#include "led_pulse.h"
+#include "uub_emu.h"
 #include <time.h>
 
-u32 *mem_addr, *mem_ptr;
-
 
 //#include <ctype.h>
 //#include <termios.h>
 
 
-#define SIG_WAKEUP SIGRTMIN+14
-#define RD_BASE 0x43c60000
-#define RD_EVENT_BASE 0x52000000
-#define RD_MEM_DEPTH 8192
-#define RD_MEM_WORDS 2048
-#define RD_MEM_NBUF 4
-
-#define MAP_SIZE 4096UL
-#define MAP_MASK (MAP_SIZE - 1)
-u32 rd_mem[RD_MEM_WORDS] __attribute__((aligned(128)));
-
-struct read_evt_global
+#define SCOPE_OUT_FILE "/srv/www/adc_RD_data.bin"
+#define SCOPE_OUT_MAX_MB 64 /* then renamed to .1, /srv/www is small */
+#define SCOPE_JSON_FILE "/srv/www/adc_RD_data.json"
+
+static const char *out_file=SCOPE_OUT_FILE;
+static const char *json_file=NULL; /* the JSON is only written if asked */
+static int json_echo=0;            /* ... and printed on stdout */
+static int json_layout=EVT_JSON_LEGACY;
+static struct evt_json_sel json_sel; /* ... what of the event it has */
+static uint32_t json_min_ms=EVT_PUB_MIN_MS;
+static struct evt_pub pub;         /* publishes json_file */
+static struct evt_file out;
+static pthread_mutex_t out_lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t out_turn=PTHREAD_COND_INITIALIZER; /* out_next moved */
+static uint32_t out_next; /* seq of the next event to write (out_lock) */
+
+#define SCOPE_MAX_WRITERS 4
+
+/* continuous acquisition: the main thread only drains the FPGA buffers
+   into the queues, the writers check and store the events. The events
+   are written in the order they were acquired (slot seq), whatever the
+   writer which has them. */
+struct scope_writer
 {
-  uint32_t id_counter;
-  uint32_t volatile *shwr_pt[5];
-  int shwr_mem_size;
-
-  uint32_t volatile *regs;
-  int regs_size;
-  uint32_t volatile *rd_regs;
-  uint32_t volatile *rd_mem_ptr;
-  int rd_mem_size;
-
-  sigset_t sigset; /*used to wake the process periodically */
+  pthread_t thread;
+  struct evt_queue q;
+  pthread_mutex_t lock;  /* waiting, with ready */
+  pthread_cond_t ready;  /* an event was queued, or the end */
+  int waiting;
+  uint32_t nwritten;
 };
 
-static struct read_evt_global gl;
-
-unsigned int countSetBits(int16_t n);
+static struct scope_writer writer[SCOPE_MAX_WRITERS];
+static volatile sig_atomic_t scope_stop=0;
+static volatile int scope_done=0;
+static volatile sig_atomic_t scope_dump=0; /* SIGUSR1: print the stats */
+static int scope_stats=0;
 
-unsigned int shwr_addr[5]={
-  TRIGGER_MEMORY_SHWR0_BASE,
-  TRIGGER_MEMORY_SHWR1_BASE,
-  TRIGGER_MEMORY_SHWR2_BASE,
-  TRIGGER_MEMORY_SHWR3_BASE,
-  TRIGGER_MEMORY_SHWR4_BASE
-};
+int usage(void);
+void FeShwrRun(int nevts,int nwriters);
+static void scope_stats_signal(int sig);
+static void scope_stats_dump(void);
 
-int main()
+int main(int argc,char *argv[])
 {
-    int fd, file,i,j, Status, data_trig, ord, width, time;
+    int fd, file,i,j, Status, data_trig, ord;
     int nev = 4096;
     int value = 0;
     int aux;
@@ -80,408 +94,436 @@ int main()
     page_offset = 16;
     FILE *fp, *fp1, *fp2;
     int nevt = 0;
-    char c;
-    void *map_base, *virt_addr;
-	unsigned long read_result, writeval;
-	off_t target;
-	time = 6200000; //width of pulse 100ns
-	width = 10; //number x 100ns
+    int c;
+	unsigned long read_result;
+
+    int wait_type=EVT_WAIT_TIMER;
+    const char *wait_dev=NULL;
+    int run=0,run_nevts=0,nwriters=1,pack=0;
+    int out_max_mb=SCOPE_OUT_MAX_MB;
+    static struct led_pulse led;
+    uint32_t led_delay=LED_PULSE_DELAY,led_width=LED_PULSE_WIDTH;
+    uint32_t led_period_us=0,led_count=0;
+    int shwr_copy=MEM_COPY_MEMCPY,rd_copy=MEM_COPY_WORD;
+    const char *copy_dev=NULL;
+    const char *dev_path=NULL;
+    static struct rd_dev dev;
+    char *p;
+    struct read_evt_rd_wait rd_wait={
+      RD_WAIT_SPIN,RD_WAIT_YIELD,RD_WAIT_SLEEP_US,RD_WAIT_TIMEOUT_US
+    };
+    rd_dev_init(&dev);
+    evt_json_sel_all(&json_sel);
+    while((c=getopt(argc,argv,"w:u:o:M:zjJ:pL:S:R:n:W:sr:P:c:C:D:A:G:T:h"))!=-1){
+      switch(c){
+      case 'w':
+        wait_type=evt_wait_type(optarg);
+        if(wait_type<0)
+          usage();
+        break;
+      case 'u':
+        wait_dev=optarg;
+        break;
+      case 'o':
+        out_file=optarg;
+        break;
+      case 'M':
+        out_max_mb=atoi(optarg);
+        if(out_max_mb<0)
+          usage();
+        break;
+      case 'z':
+        pack=1;
+        break;
+      case 'j':
+        json_file=SCOPE_JSON_FILE;
+        break;
+      case 'J':
+        json_file=optarg;
+        break;
+      case 'p':
+        json_echo=1;
+        break;
+      case 'L':
+        json_layout=evt_json_layout(optarg);
+        if(json_layout<0)
+          usage();
+        break;
+      case 'S':
+        if(evt_json_sel_parse(&json_sel,optarg)!=0)
+          usage();
+        break;
+      case 'R':
+        json_min_ms=atoi(optarg);
+        break;
+      case 'n':
+        run=1;
+        run_nevts=atoi(optarg);
+        break;
+      case 'W':
+        nwriters=atoi(optarg);
+        if(nwriters<1 || nwriters>SCOPE_MAX_WRITERS)
+          usage();
+        break;
+      case 's':
+        scope_stats=1;
+        break;
+      case 'r':
+        if(sscanf(optarg,"%u:%u:%u:%u",&rd_wait.spin,&rd_wait.yield,
+                  &rd_wait.sleep_us,&rd_wait.timeout_us)!=4)
+          usage();
+        rd_wait.timeout_us*=1000; /* given in ms */
+        break;
+      case 'P':
+        read_evt_set_parity_budget(atoi(optarg));
+        break;
+      case 'c':
+        p=strchr(optarg,':');
+        if(p!=NULL)
+          *p++='\0';
+        shwr_copy=mem_copy_type(optarg);
+        rd_copy=(p!=NULL) ? mem_copy_type(p) : shwr_copy;
+        if(shwr_copy<0 || rd_copy<0)
+          usage();
+        break;
+      case 'C':
+        copy_dev=optarg;
+        break;
+      case 'D':
+        dev_path=optarg;
+        break;
+      case 'A':
+        if(rd_dev_set_addr(&dev,optarg)!=0)
+          usage();
+        break;
+      case 'G':
+        if(sscanf(optarg,"%u:%u",&led_width,&led_delay)<1)
+          usage();
+        break;
+      case 'T':
+        if(sscanf(optarg,"%u:%u",&led_period_us,&led_count)<1)
+          usage();
+        led_period_us*=1000; /* given in ms */
+        break;
+      default:
+        usage();
+      }
+    }
 
+    if(evt_file_open(&out,out_file,1)!=0)
+      return(1);
+    evt_file_set_max_size(&out,(uint64_t)out_max_mb<<20);
+    evt_file_set_pack(&out,pack);
+    if(json_file!=NULL &&
+       evt_pub_init(&pub,json_file,json_layout,&json_sel,json_min_ms)!=0)
+      return(1);
+    read_evt_set_wait(wait_type,wait_dev);
+    read_evt_set_rd_wait(&rd_wait);
+    read_evt_set_copy(shwr_copy,rd_copy,copy_dev);
+    if(rd_dev_open(&dev,dev_path,RD_DEV_ALL)!=0)
+      return(1);
+    if(dev.stand_in)
+      uub_emu_attach(&dev); /* the model runs in a uub_emu process */
+    read_evt_set_dev(&dev);
+    if(led_pulse_init(&led,&dev)!=0 ||
+       led_pulse_set(&led,led_delay,led_width)!=0){
+      rd_dev_close(&dev);
+      return(1);
+    }
     aux=read_evt_init();
     if(aux!=0){
       printf("FeShwrRead: Problem in start the Front-End - (shower read) %d \n",aux);
+      rd_dev_close(&dev);
       return(0);
     }
-    clock_t start,end;
-    double tempo;
-    start=clock();
+    if(led_period_us>0 && led_pulse_start(&led,led_period_us,led_count)!=0){
+      read_evt_end();
+      rd_dev_close(&dev);
+      return(1);
+    }
+    if(scope_stats){
+      struct sigaction sa;
 
+      memset(&sa,0,sizeof(sa));
+      sa.sa_handler=scope_stats_signal;
+      sigaction(SIGUSR1,&sa,NULL);
+      read_evt_stats_enable(1);
+    }
+
+    if(run){
+      FeShwrRun(run_nevts,nwriters);
+      nevt=1; /* the single event loop below is not used */
+    }
 
     while(nevt<1)
     {
-    	if (gl.regs[SHWR_BUF_TRIG_MASK_ADDR] == 0x10000){
-    		target = 0x43c203fc;
-    		        	     if((fd = open("/dev/mem", O_RDWR | O_SYNC)) == -1);
-    		        	     	map_base = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, target & ~MAP_MASK);
-    		        	     	virt_addr = map_base + (target & MAP_MASK);
-
-    		        	     	writeval = (time * width);
-    		        	     	*((unsigned long *) virt_addr) = writeval;
-    		        	     	usleep (100);
-    		        	     	 writeval = (time * width) +1;
-    		        	     	*((unsigned long *) virt_addr) = writeval;
-    		        	     	close(fd);
-
-    	}
+    	/* LED trigger only: fire the pulse of the event, unless the
+    	   pulse train does it */
+    	if (read_evt_regs()[SHWR_BUF_TRIG_MASK_ADDR] == SHWR_BUF_TRIG_LED &&
+    	    !led.running)
+    		led_pulse_fire(&led);
 
     	FeShwrRead_test(1);
 
         nevt++;
     }
 
-    end=clock();
-    tempo=((double)(end-start))/CLOCKS_PER_SEC;
-   // printf("tempo %lf\n", tempo);
+    led_pulse_stop(&led);
+    if(scope_stats){
+      evt_stats_print(stdout,read_evt_stats());
+      read_evt_rd_health_print(stdout);
+      ttag_cal_print(stdout,read_evt_ttag_cal());
+      if(led.npulses>0)
+        led_pulse_print(stdout,&led);
+      if(out.pack)
+        printf("event file: %llu bytes of traces written as %llu (%.2f)\n",
+               (unsigned long long)out.nraw,(unsigned long long)out.npacked,
+               (double)out.nraw/out.npacked);
+      if(json_file!=NULL)
+        evt_pub_print(stdout,&pub);
+    }
+    if(json_file!=NULL)
+      evt_pub_end(&pub);
     read_evt_end();
+    rd_dev_close(&dev);
+    evt_file_close(&out);
 
 }
 
 
-/*please do not use the signal SIGRTMIN+15 because it will probaly be
-  used in other part of the code ...*/
-
-int read_evt_init()
+/* rd is NULL if the RD data is missing; flags are the lease flags */
+static void scope_output(const struct shwr_evt_raw *evt,const uint32_t *rd,
+			 uint32_t flags)
 {
-  int fd,i;
-  int size;
-  struct sigevent sev;
-  timer_t t_alarm;
-
-  for(i=0;i<5;i++){
-    gl.shwr_pt[i]=NULL;
-  }
-  gl.regs=NULL;
-
-  fd=open("/dev/mem",O_RDWR);
-  if(fd<0){
-    printf("Error - it was not possible to open the /dev/mem for read/write regitsters\n");
-    exit(1);
-  }
-  size=256*sizeof(uint32_t);
-  if(size%sysconf(_SC_PAGE_SIZE)){
-    size=(size/sysconf(_SC_PAGE_SIZE)+1)*sysconf(_SC_PAGE_SIZE);
-  }
-  gl.regs_size=size;
-  gl.regs=(uint32_t *)mmap(NULL, size,
-				PROT_READ | PROT_WRITE, MAP_SHARED,
-				fd,SDE_TRIGGER_BASE);
-  if(gl.regs==MAP_FAILED){
-    printf("Error - while trying to map the Registers\n");
-    exit(1);
-  }
-  close(fd); //it is not needed to keep opened
-
-  fd=open("/dev/mem",O_RDWR);
-
-  //mapping RD
- // printf("map_rd: Mapping rd_regs to %x\n", RD_BASE);
-       gl.rd_regs=(u32 *)mmap(NULL, size,
-                          PROT_READ | PROT_WRITE, MAP_SHARED,
-                          fd, RD_BASE);
-      if (gl.rd_regs==MAP_FAILED){
-        printf("Error - while trying to map rd registers\n");
-        exit(1);
-      }
-
-      close(fd);
-
-  size=SHWR_MEM_DEPTH*SHWR_MEM_NBUF;
-  if(size%sysconf(_SC_PAGE_SIZE)){
-    size=(size/sysconf(_SC_PAGE_SIZE)+1)*sysconf(_SC_PAGE_SIZE);
-  }
-  gl.shwr_mem_size=size;
-  for(i=0;i<5;i++){
-    fd=open("/dev/mem",O_RDONLY);
-    if(fd<0){
-      printf("Error - open the /dev/mem for read shower buffers\n");
-      exit(1);
-    }
-    gl.shwr_pt[i]=(uint32_t *)mmap(NULL,size,
-				   PROT_READ,MAP_SHARED,
-				   fd,shwr_addr[i]);
-    if(gl.shwr_pt[i]==MAP_FAILED){
-      printf("ERROR- failed to map the shower buffers: %d\n",i);
-      exit(1);
-    }
-    close(fd);
-  }
-
-
-
-
-  fd=open("/dev/mem",O_RDWR);
-
- //   printf("map_rd: Mapping rd memory\n");
-      size =RD_MEM_DEPTH*RD_MEM_NBUF;
-      gl.rd_mem_size=size;
-      gl.rd_mem_ptr = (u32)mmap(NULL, size,
-                                   PROT_WRITE|PROT_READ, MAP_SHARED,
-                                   fd,RD_EVENT_BASE);
-      if (gl.rd_mem_ptr == (u32)MAP_FAILED){
-        printf("Error - while trying to map rd memory %d\n", 0);
-        exit(1);
-      }
-
-      close(fd);
-
-  //setting periodical process wakeup to check if there are event. It is ugly, but for now, it would work in this whay, until we figure a what to implement interruptions through the kernel
-
-  //signal of alarm handler - it is going to be just blocked to be used with sigtimedwait system call.
-
-  if(sigemptyset(&gl.sigset)!=0){
-    printf("error while trying to set signals ... 1 \n");
-    exit(1);
-  }
-  if(sigaddset(&gl.sigset,SIG_WAKEUP)!=0){
-    printf("error while trying to set signals ... 2\n");
-    exit(1);
-  }
-  if(sigprocmask(SIG_BLOCK,&gl.sigset,NULL)!=0){
-    printf("error while trying to set signals ... 3 \n");
-    exit(1);
+  struct evt_file_hdr h;
+  uint32_t fflags;
+  int pub_it;
+
+  fflags=(flags & EVT_LEASE_RD_PARITY) ? EVT_FILE_RD_PARITY : 0;
+  pthread_mutex_lock(&out_lock);
+  if(evt_file_write_raw(&out,evt,rd,RD_MEM_WORDS,fflags)!=0)
+    printf("FeShwrRead: error writing the event %d to %s\n",evt->id,out_file);
+  pthread_mutex_unlock(&out_lock);
+
+  pub_it=(json_file!=NULL && evt_pub_claim(&pub));
+  if(!pub_it && !json_echo)
+    return;
+  evt_file_hdr_init(&h,evt,(rd!=NULL) ? RD_MEM_WORDS : 0);
+  if(rd==NULL)
+    h.flags|=EVT_FILE_RD_MISSING;
+  h.flags|=fflags;
+  /* not under out_lock: the web page does not hold the writers */
+  if(pub_it)
+    evt_pub_write(&pub,&h,(const uint32_t (*)[SHWR_NSAMPLES])evt->fadc_raw,
+		  rd);
+  if(json_echo){
+    pthread_mutex_lock(&out_lock);
+    if(json_layout==EVT_JSON_COLUMNS)
+      evt_json_write_columns(stdout,&h,
+			     (const uint32_t (*)[SHWR_NSAMPLES])evt->fadc_raw,
+			     rd,&json_sel);
+    else
+      evt_json_write(stdout,&h,
+		     (const uint32_t (*)[SHWR_NSAMPLES])evt->fadc_raw,rd);
+    pthread_mutex_unlock(&out_lock);
   }
+}
 
-  // periodical signal generation
-  sev.sigev_notify=SIGEV_SIGNAL;
-  sev.sigev_signo=SIG_WAKEUP;
-  if(timer_create(CLOCK_MONOTONIC,&sev,&t_alarm)!=0){
-    printf("timer creation error\n");
-    exit(1);
-  } else {
-    struct itimerspec ts;
-    ts.it_interval.tv_sec=0;
-    ts.it_interval.tv_nsec=100000; //.1 ms
-    ts.it_value.tv_sec=0;
-    ts.it_value.tv_nsec=100000;//the next interruption would appear in .1ms
-    if(timer_settime(t_alarm, 0, &ts, NULL)!=0){
-      exit(1);
-    }
+void FeShwrRead_test(int Nev)
+{
+  struct shwr_evt_raw evt;
+  struct evt_lease *l;
+  uint32_t rd_status,flags;
+  int rd_buf;
+
+  int ret;
+
+  while((l=read_evt_lease())==NULL); /*wait for a available event */
+  ret=read_evt_lease_copy(l,&evt,rd_mem);
+  rd_buf=l->rd_buf;
+  rd_status=l->rd_status;
+  flags=l->flags;
+  /* the check and the output work on the copy, as in FeShwrRun */
+  read_evt_release(l);
+  if(ret!=0){
+    printf("FeShwrRead: the event could not be copied, not written\n");
+    return;
   }
-  gl.id_counter=0;
-  return(0);
+  if(!(flags & EVT_LEASE_RD_MISSING) &&
+     read_evt_rd_check(rd_mem,rd_buf,rd_status))
+    flags|=EVT_LEASE_RD_PARITY;
+  scope_output(&evt,(flags & EVT_LEASE_RD_MISSING) ? NULL : rd_mem,flags);
 }
 
-
-
-
-int read_evt_end()
+static void scope_signal(int sig)
 {
-  int i;
-  void *aux;
+  scope_stop=1;
+}
 
-  if(gl.regs!=NULL){
-    aux=(void *)gl.regs;
-    munmap(aux,gl.regs_size);
-  }
-  for(i=0;i<5;i++){
-    if(gl.shwr_pt[i]!=NULL){
-      aux=(void *)gl.shwr_pt[i];
-      munmap(aux,gl.shwr_mem_size);
-    }
-  }
-  if(gl.rd_mem_ptr!=NULL){
-      aux=(void *)gl.rd_mem_ptr;
-      munmap(aux,gl.rd_mem_size);
-    }
+static void scope_stats_signal(int sig)
+{
+  scope_dump=1;
+}
 
+/* print the stats asked with SIGUSR1, out of the signal handler */
+static void scope_stats_dump(void)
+{
+  struct trig_mon_shm rates;
+
+  if(!scope_dump)
+    return;
+  scope_dump=0;
+  evt_stats_print(stdout,read_evt_stats());
+  read_evt_rd_health_print(stdout);
+  ttag_cal_print(stdout,read_evt_ttag_cal());
+  /* published by trig_mon, if it runs */
+  if(trig_mon_shm_read(NULL,&rates)==0)
+    trig_mon_shm_print(stdout,&rates,0);
+  if(json_file!=NULL)
+    evt_pub_print(stdout,&pub);
+  fflush(stdout);
 }
 
-int read_evt_read(struct shwr_evt_raw *shwr)
+static void *scope_writer_thread(void *arg)
 {
-  uint32_t volatile *st;
-  void *pt_aux;
-  uint32_t aux;
-  fd_set frds;
-  int rd,sig,i;
-  int offset;
-  int toread_rd_buf_num;
-  int cur_rd_buf_num = 0;
-  int full_rd_bufs = 0;
-  int busy_rd_bufs = 0;
-  int cntrl_word = 0;
-  int num_full;
-  int shwr_status, rd_status;
-  int trig_id, rd_id;
-  int parity0, parity1;
-  int read0, read1;
-  int expected0, expected1;
-  int nerrors = 0;
-  st=&(gl.regs[SHWR_BUF_STATUS_ADDR]);
-
-  /*wait for the periodical signal and check if there is a
-    event trigger
-  */
-  aux=SHWR_BUF_NFULL_MASK<<SHWR_BUF_NFULL_SHIFT;
-  sig=SIG_WAKEUP;
-
-  while( ((*st) & aux)==0 && sig==SIG_WAKEUP)
-    sig=sigwaitinfo(&gl.sigset,NULL);
-
-  if(sig==SIG_WAKEUP){
-    rd=(((*st)>>SHWR_BUF_RNUM_SHIFT) & SHWR_BUF_RNUM_MASK);
-    offset=rd*SHWR_NSAMPLES;
-    for(i=0;i<5;i++){
-      pt_aux=(void *)(gl.shwr_pt[i]+offset);
-      memcpy(shwr->fadc_raw[i],
-	     pt_aux,
-	     sizeof(uint32_t)*SHWR_NSAMPLES);
+  struct scope_writer *w=(struct scope_writer *)arg;
+  struct evt_slot *slot;
+
+  for(;;){
+    slot=evt_queue_peek(&w->q);
+    if(slot==NULL){
+      /* sleep until FeShwrRun queues an event or ends */
+      pthread_mutex_lock(&w->lock);
+      w->waiting=1;
+      while((slot=evt_queue_peek(&w->q))==NULL &&
+	    !__atomic_load_n(&scope_done,__ATOMIC_ACQUIRE))
+	pthread_cond_wait(&w->ready,&w->lock);
+      w->waiting=0;
+      pthread_mutex_unlock(&w->lock);
+      if(slot==NULL)
+	break;
     }
-    shwr->id=gl.id_counter; /*just a internal counter */
-    shwr->trace_start=gl.regs[SHWR_BUF_START_ADDR];
-    shwr->Evt_type_1=gl.regs[SHWR_BUF_TRIG_ID_ADDR];
-    shwr->Evt_type_2=0;
-    shwr->ev_gps_info.second=gl.regs[TTAG_SHWR_SECONDS_ADDR];
-    shwr->ev_gps_info.ticks=gl.regs[TTAG_SHWR_NANOSEC_ADDR];
-
-    busy_rd_bufs = 1;
-           while (busy_rd_bufs != 0)
-             {
-               rd_status = gl.rd_regs[RD_IFC_STATUS_ADDR];
-               toread_rd_buf_num = RD_BUF_RNUM_MASK &
-                 (rd_status >> RD_BUF_RNUM_SHIFT);
-               cur_rd_buf_num = RD_BUF_WNUM_MASK &
-                 (rd_status >> RD_BUF_WNUM_SHIFT);
-               full_rd_bufs = RD_BUF_FULL_MASK &
-                 (rd_status >> RD_BUF_FULL_SHIFT);
-               busy_rd_bufs = RD_BUF_BUSY_MASK &
-                 (rd_status >> RD_BUF_BUSY_SHIFT);
-               parity0 = RD_PARITY0_MASK &
-                 (rd_status >> RD_PARITY0_SHIFT);
-               parity1 = RD_PARITY1_MASK &
-                 (rd_status >> RD_PARITY1_SHIFT);
-             }
-
-             // Read RD buffer
-
-           mem_addr = (u32*) gl.rd_mem_ptr;
-           mem_addr = mem_addr + toread_rd_buf_num * RD_MEM_WORDS;
-           mem_ptr = mem_addr;
-           for (i=0; i<RD_MEM_WORDS; i++)
-             {
-               rd_mem[i] = *mem_ptr;
-               mem_ptr++;
-             }
-
-
-    gl.regs[SHWR_BUF_CONTROL_ADDR]=rd;
-    gl.rd_regs[RD_IFC_CONTROL_ADDR]=toread_rd_buf_num;
-    gl.id_counter++;
-    return(0);
+    /* the check runs in parallel, the writes go in acquisition order */
+    if(!(slot->flags & EVT_LEASE_RD_MISSING) &&
+       read_evt_rd_check(slot->rd,slot->rd_buf,slot->rd_status))
+      slot->flags|=EVT_LEASE_RD_PARITY;
+    pthread_mutex_lock(&out_lock);
+    while(out_next!=slot->seq)
+      pthread_cond_wait(&out_turn,&out_lock);
+    pthread_mutex_unlock(&out_lock);
+    scope_output(&slot->evt,
+		 (slot->flags & EVT_LEASE_RD_MISSING) ? NULL : slot->rd,
+		 slot->flags);
+    pthread_mutex_lock(&out_lock);
+    out_next++;
+    pthread_cond_broadcast(&out_turn);
+    pthread_mutex_unlock(&out_lock);
+    evt_queue_pop(&w->q);
+    w->nwritten++;
   }
-  return(1);
+  return(NULL);
 }
 
-FeShwrRead_test(int Nev)
-{
-  int aux;
-  struct shwr_evt_raw evt;
-  int nevts,i,j,index;
-  FILE *fp;
-
-  while(read_evt_read(&evt)!=0); /*wait for a available event */
-
-    fp = fopen ("/srv/www/adc_RD_data.json", "w" );
-
-
-   fprintf(fp,"[");
-   printf("[");
-
-    for(j=0;j<SHWR_NSAMPLES;j++){
-      index=(j+evt.trace_start)%SHWR_NSAMPLES;
-      fprintf(fp,"{");
-      printf("{");
-      for(i=0;i<SHWR_RAW_NCH_MAX;i++){
-    	  fprintf(fp,"\"adc%d\": \"%d\"",i*2, evt.fadc_raw[i][index] & 0xFFF);
-    	  fprintf(fp,", \"adc%d\": \"%d\"",i*2+1,(evt.fadc_raw[i][index]>>16) & 0xFFF);
-
-    	  printf  ("\"adc%d\": \"%d\"",i*2, evt.fadc_raw[i][index] & 0xFFF);
-    	  printf(", \"adc%d\": \"%d\"",i*2+1,(evt.fadc_raw[i][index]>>16) & 0xFFF);
-
-
-
-    	 // if (i != 4) {fprintf(fp,", ");
-    	  fprintf(fp, ", ");
-     	  printf(", ");
-    	 // }
-      }
-     //fprintf(fp, "\"adc_rd0_parity\": \"%d\", ", rd_mem[j] & 0x1);
-     // printf("\"adc_rd0_parity\": \"%d\", ", rd_mem[j] & 0x1);
-
- 	 unsigned int p0, p1, check0=0, check1=0;
-      int16_t adc_rd0=((int16_t)((rd_mem[j]>>1) & 0xfff));
-      int16_t adc_rd1=((int16_t)((rd_mem[j]>>17) & 0xfff));
-
-  /*
-
-     if (((int16_t)((rd_mem[j]>>1) & 0xfff))>>11==1)
-     {
-     fprintf(fp, "\"adc_rd0\": \"%d\", ",~((int16_t)((rd_mem[j]>>1) & 0x7ff)-1));
-     printf("\"adc_rd0\": \"%d\", ",~((int16_t)((rd_mem[j]>>1) & 0x7ff)-1));
-     }
-
-     if (((int16_t)((rd_mem[j]>>1) & 0xfff))>>11==0)
-          {
-          fprintf(fp, "\"adc_rd0\": \"%d\", ",((int16_t)((rd_mem[j]>>1) & 0x7ff)));
-          printf("\"adc_rd0\": \"%d\", ",((int16_t)((rd_mem[j]>>1) & 0x7ff)));
-          }
-     //fprintf(fp, "\"adc_rd1_parity\": \"%d\", ", (rd_mem[j]>>16) & 0x1);
-     // printf("\"adc_rd1_parity\": \"%d\", ", (rd_mem[j]>>16) & 0x1);
-
-     if(((int16_t)((rd_mem[j]>>17) & 0xfff))>>11==1)
-     {
-     fprintf(fp, "\"adc_rd1\": \"%d\", ",~((int16_t)((rd_mem[j]>>17) & 0x7ff)-1));
-     printf("\"adc_rd1\": \"%d\", ",~((int16_t)((rd_mem[j]>>17) & 0x7ff)-1));
-     }
-
-     if(((int16_t)((rd_mem[j]>>17) & 0xfff))>>11==0)
-     {
-    	 fprintf(fp, "\"adc_rd1\": \"%d\", ",((int16_t)((rd_mem[j]>>17) & 0x7ff)));
-    	 printf("\"adc_rd1\": \"%d\", ",((int16_t)((rd_mem[j]>>17) & 0x7ff)));
-     }
-
-
+/* Acquire nevts events (0: until SIGINT/SIGTERM) with nwriters writer
+   threads. The main thread keeps the FPGA buffers for the time of a
+   copy only; the format and disk speed do not change the dead time as
+   long as the queues are not full.
 */
-      fprintf(fp, "\"adc_rd0\": \"%d\", ", (adc_rd0>2047) ? (adc_rd0-4096) : adc_rd0);
-      printf("\"adc_rd0\": \"%d\", ", (adc_rd0>2047) ? (adc_rd0-4096) : adc_rd0);
-
-  	  fprintf(fp, "\"adc_rd1\": \"%d\", ", (adc_rd1>2047) ? (adc_rd1-4096) : adc_rd1);
-      printf("\"adc_rd1\": \"%d\", ", (adc_rd1>2047) ? (adc_rd1-4096) : adc_rd1);
-
-     p0=countSetBits(adc_rd0);
-     p1=countSetBits(adc_rd1);
-
-     //printf("parametro p %d\n", p);
-
-     if (p0%2==0 && (rd_mem[j] & 0x1)!=1)
-              check0=1;
-
-     if (p0%2!=0 && (rd_mem[j] & 0x1)!=0)
-                    check0=1;
-
-      if (p1%2==0 && ((rd_mem[j]>>16) & 0x1)!=1)
-          check1=1;
-
-      if (p1%2!=0 && ((rd_mem[j]>>16) & 0x1)!=0)
-                check1=1;
-
-
-     printf("\"check0\": \"%d\", ", check0);
-     printf("\"check1\": \"%d\"", check1);
-
-
-
-     fprintf(fp,"}");
-     printf("}");
-     if (j!=SHWR_NSAMPLES-1)  {fprintf(fp,", ");
-     printf(", ");
-      }
+void FeShwrRun(int nevts,int nwriters)
+{
+  struct sigaction sa;
+  sigset_t mask,old;
+  struct evt_lease *l;
+  struct evt_slot *slot;
+  struct scope_writer *w;
+  uint32_t nacq=0,nstall=0,nwritten=0,ndrop=0;
+  int i,next=0;
+
+  memset(&sa,0,sizeof(sa));
+  sa.sa_handler=scope_signal; /* no SA_RESTART: the wait is interrupted */
+  sigaction(SIGINT,&sa,NULL);
+  sigaction(SIGTERM,&sa,NULL);
+
+  /* the writers must not take the stop and stats signals */
+  sigemptyset(&mask);
+  sigaddset(&mask,SIGINT);
+  sigaddset(&mask,SIGTERM);
+  sigaddset(&mask,SIGUSR1);
+  pthread_sigmask(SIG_BLOCK,&mask,&old);
+  out_next=0;
+  for(i=0;i<nwriters;i++){
+    w=&writer[i];
+    w->nwritten=0;
+    w->waiting=0;
+    pthread_mutex_init(&w->lock,NULL);
+    pthread_cond_init(&w->ready,NULL);
+    if(evt_queue_init(&w->q,EVT_QUEUE_DEPTH)!=0 ||
+       pthread_create(&w->thread,NULL,scope_writer_thread,w)!=0){
+      printf("FeShwrRun: not possible to start the writer %d\n",i);
+      nwriters=i;
+      break;
     }
- 	 fprintf(fp,"]\n");
- 	 printf("]");
-
- 	 fclose(fp);
-
-}
+  }
+  pthread_sigmask(SIG_SETMASK,&old,NULL);
+
+  while(nwriters>0 && !scope_stop && (nevts==0 || nacq<nevts)){
+    scope_stats_dump();
+    l=read_evt_lease();
+    if(l==NULL)
+      continue; /* interrupted */
+
+    /* round robin on the writers; if all the queues are full wait for
+       the first one, the FPGA buffers fill meanwhile */
+    slot=NULL;
+    for(i=0;i<nwriters && slot==NULL;i++){
+      w=&writer[(next+i)%nwriters];
+      slot=evt_queue_claim(&w->q);
+    }
+    if(slot==NULL){
+      nstall++;
+      w=&writer[next];
+      while((slot=evt_queue_claim(&w->q))==NULL)
+	sched_yield();
+    }
+    if(read_evt_lease_copy(l,&slot->evt,slot->rd)!=0){
+      /* not queued: the slot is claimed again for the next event */
+      read_evt_release(l);
+      ndrop++;
+      nacq++;
+      continue;
+    }
+    slot->rd_buf=l->rd_buf;
+    slot->rd_status=l->rd_status;
+    slot->flags=l->flags;
+    slot->seq=nacq-ndrop; /* the events queued, without gaps */
+    read_evt_release(l);
+    evt_queue_push(&w->q);
+    pthread_mutex_lock(&w->lock);
+    if(w->waiting)
+      pthread_cond_signal(&w->ready);
+    pthread_mutex_unlock(&w->lock);
+    next=(w-writer+1)%nwriters;
+    nacq++;
+  }
 
-unsigned int countSetBits(int16_t n)
-{
-unsigned int count = 0;
-while (n)
-{
-    count += n & 1;
-    n >>= 1;
-}
-return count;
+  __atomic_store_n(&scope_done,1,__ATOMIC_RELEASE);
+  for(i=0;i<nwriters;i++){
+    pthread_mutex_lock(&writer[i].lock);
+    pthread_cond_signal(&writer[i].ready);
+    pthread_mutex_unlock(&writer[i].lock);
+  }
+  for(i=0;i<nwriters;i++){
+    pthread_join(writer[i].thread,NULL);
+    nwritten+=writer[i].nwritten;
+    evt_queue_free(&writer[i].q);
+    pthread_mutex_destroy(&writer[i].lock);
+    pthread_cond_destroy(&writer[i].ready);
+  }
+  evt_file_flush(&out);
+  printf("FeShwrRun: %u events acquired, %u written, %u not copied, "
+	 "%u queue full waits\n",nacq,nwritten,ndrop,nstall);
+  read_evt_rd_health_print(stdout);
+  ttag_cal_print(stdout,read_evt_ttag_cal());
 }
 
 int usage(void)
@@ -492,6 +534,48 @@ int usage(void)
     printf("|   -i internal trigger    |\n");
     printf("|   -t threshold trigger   |\n");
     printf("|   -l LED acquisition     |\n");
+    printf("|   -w timer|uio|eventfd   |\n");
+    printf("|      event wait mode     |\n");
+    printf("|   -u UIO device          |\n");
+    printf("|      (default /dev/uio0) |\n");
+    printf("|   -o binary event file   |\n");
+    printf("|   -M MB to keep in the   |\n");
+    printf("|      file, then .1 (64,  |\n");
+    printf("|      0: no limit)        |\n");
+    printf("|   -z compress the traces |\n");
+    printf("|   -j write the JSON file |\n");
+    printf("|   -J JSON file name      |\n");
+    printf("|   -p print the JSON      |\n");
+    printf("|   -L JSON legacy|columns |\n");
+    printf("|      (default legacy,    |\n");
+    printf("|      scope_rd_2.1.html)  |\n");
+    printf("|   -S ch[:start:len[:dec]]|\n");
+    printf("|      columns selection:  |\n");
+    printf("|      all|0,1,..,rd0,rd1, |\n");
+    printf("|      start from trigger, |\n");
+    printf("|      min/max decimation  |\n");
+    printf("|   -R min ms between JSON |\n");
+    printf("|      files (0: all)      |\n");
+    printf("|   -n N continuous run    |\n");
+    printf("|      (0: until SIGINT)   |\n");
+    printf("|   -W number of writers   |\n");
+    printf("|   -s readout statistics  |\n");
+    printf("|      (SIGUSR1: print)    |\n");
+    printf("|   -r spin:yield:sleep_us:|\n");
+    printf("|      timeout_ms RD wait  |\n");
+    printf("|   -P RD parity errors    |\n");
+    printf("|      allowed in a event  |\n");
+    printf("|   -c shwr[:rd] copy:     |\n");
+    printf("|      word|memcpy|wide|   |\n");
+    printf("|      simd|dma            |\n");
+    printf("|   -C DMA device          |\n");
+    printf("|   -D memory device or    |\n");
+    printf("|      stand-in directory  |\n");
+    printf("|   -A region=hex address  |\n");
+    printf("|   -G LED pulse           |\n");
+    printf("|      width[:delay]       |\n");
+    printf("|   -T LED pulse train     |\n");
+    printf("|      period_ms[:count]   |\n");
     printf("|                          |\n");
     printf("|    written by R.Assiro   |\n");
     printf("|      and G.Marsella      |\n");
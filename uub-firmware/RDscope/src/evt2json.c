@@ -0,0 +1,114 @@
+// Convert the binary event records written by the scope (evt_file.h)
+// into the JSON the scope web page reads.
+//
+//   evt2json [-n record] [-L legacy|columns] [-S selection] [-o out.json]
+//            events.bin
+//
+// Without -n the last record of the file is converted; -n counts from
+// 0, negative values count from the end (-1 is the last record). -S
+// selects the channels, window and decimation of the columns layout
+// (evt_json_sel_parse): channels[:start:len[:decim]]. The layout is
+// legacy unless -L columns, as scope_rd_2.1.html reads it.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "evt_file.h"
+
+#define EVT2JSON_RD_MAX 8192
+
+static uint32_t fadc_raw[SHWR_RAW_NCH_MAX][SHWR_NSAMPLES];
+static uint32_t rd[EVT2JSON_RD_MAX];
+
+static void usage(const char *prog)
+{
+  printf("usage: %s [-n record] [-L legacy|columns] [-S selection]\n"
+	 "       [-o out.json] events.bin\n",prog);
+  exit(1);
+}
+
+int main(int argc,char *argv[])
+{
+  struct evt_file_hdr h;
+  struct evt_json_sel sel;
+  FILE *in,*out;
+  const char *out_name=NULL;
+  long nrec,want=-1,i;
+  int c,ret,layout=EVT_JSON_LEGACY;
+
+  evt_json_sel_all(&sel);
+  while((c=getopt(argc,argv,"n:L:S:o:h"))!=-1){
+    switch(c){
+    case 'n':
+      want=atol(optarg);
+      break;
+    case 'o':
+      out_name=optarg;
+      break;
+    case 'L':
+      layout=evt_json_layout(optarg);
+      if(layout<0)
+	usage(argv[0]);
+      break;
+    case 'S':
+      if(evt_json_sel_parse(&sel,optarg)!=0)
+	usage(argv[0]);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if(optind!=argc-1)
+    usage(argv[0]);
+
+  in=fopen(argv[optind],"rb");
+  if(in==NULL){
+    perror(argv[optind]);
+    return(1);
+  }
+
+  /* count the records, only the headers are read */
+  nrec=0;
+  while(fread(&h,sizeof(h),1,in)==1 && h.magic==EVT_FILE_MAGIC &&
+	fseek(in,(long)h.size-sizeof(h),SEEK_CUR)==0)
+    nrec++;
+  if(want<0)
+    want+=nrec;
+  if(want<0 || want>=nrec){
+    printf("evt2json: %s has %ld records\n",argv[optind],nrec);
+    return(1);
+  }
+
+  rewind(in);
+  for(i=0;i<want;i++){
+    if(fread(&h,sizeof(h),1,in)!=1 ||
+       fseek(in,(long)h.size-sizeof(h),SEEK_CUR)!=0)
+      return(1);
+  }
+  ret=evt_file_read(in,&h,fadc_raw,rd,EVT2JSON_RD_MAX);
+  fclose(in);
+  if(ret!=0){
+    printf("evt2json: error reading record %ld\n",want);
+    return(1);
+  }
+
+  out=stdout;
+  if(out_name!=NULL){
+    out=fopen(out_name,"w");
+    if(out==NULL){
+      perror(out_name);
+      return(1);
+    }
+  }
+  if(layout==EVT_JSON_COLUMNS)
+    ret=evt_json_write_columns(out,&h,
+			       (const uint32_t (*)[SHWR_NSAMPLES])fadc_raw,rd,
+			       &sel);
+  else
+    ret=evt_json_write(out,&h,(const uint32_t (*)[SHWR_NSAMPLES])fadc_raw,rd);
+  if(out!=stdout)
+    ret|=(fclose(out)!=0);
+  return(ret);
+}
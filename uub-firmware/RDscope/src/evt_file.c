@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "evt_file.h"
+#include "trace_pack.h"
+
+int evt_file_open(struct evt_file *f,const char *path,int append)
+{
+  f->nrecords=0;
+  f->buf=NULL;
+  f->pack=0;
+  f->pack_buf=NULL;
+  f->pack_size=0;
+  f->nraw=0;
+  f->npacked=0;
+  f->size=0;
+  f->max_size=0;
+  f->nrotate=0;
+  strncpy(f->path,path,sizeof(f->path)-1);
+  f->path[sizeof(f->path)-1]='\0';
+  f->fp=fopen(path,append ? "ab" : "wb");
+  if(f->fp==NULL){
+    printf("evt_file: not possible to open %s: %s\n",path,strerror(errno));
+    return(1);
+  }
+  if(append && fseeko(f->fp,0,SEEK_END)==0)
+    f->size=ftello(f->fp);
+  /* the records are big, it is not worth to go to the kernel for
+     each piece of them */
+  f->buf=malloc(EVT_FILE_BUFSIZE);
+  if(f->buf!=NULL)
+    setvbuf(f->fp,f->buf,_IOFBF,EVT_FILE_BUFSIZE);
+  return(0);
+}
+
+int evt_file_flush(struct evt_file *f)
+{
+  if(f->fp==NULL)
+    return(1);
+  return(fflush(f->fp)!=0);
+}
+
+int evt_file_close(struct evt_file *f)
+{
+  int ret=0;
+
+  if(f->fp!=NULL){
+    ret=(fclose(f->fp)!=0);
+    f->fp=NULL;
+  }
+  free(f->buf);
+  f->buf=NULL;
+  free(f->pack_buf);
+  f->pack_buf=NULL;
+  f->pack_size=0;
+  return(ret);
+}
+
+void evt_file_set_pack(struct evt_file *f,int pack)
+{
+  f->pack=pack;
+}
+
+void evt_file_set_max_size(struct evt_file *f,uint64_t max)
+{
+  f->max_size=max;
+}
+
+static int evt_file_rotate(struct evt_file *f)
+{
+  char old[sizeof(f->path)+2];
+
+  if(fclose(f->fp)!=0)
+    printf("evt_file: error closing %s: %s\n",f->path,strerror(errno));
+  snprintf(old,sizeof(old),"%s.1",f->path);
+  if(rename(f->path,old)!=0)
+    printf("evt_file: not possible to rename %s: %s\n",f->path,
+	   strerror(errno));
+  f->fp=fopen(f->path,"wb");
+  if(f->fp==NULL){
+    printf("evt_file: not possible to open %s: %s\n",f->path,
+	   strerror(errno));
+    return(1);
+  }
+  if(f->buf!=NULL)
+    setvbuf(f->fp,f->buf,_IOFBF,EVT_FILE_BUFSIZE);
+  f->size=0;
+  f->nrotate++;
+  return(0);
+}
+
+void evt_file_hdr_init(struct evt_file_hdr *h,
+		       const struct shwr_evt_raw *evt,int rd_nwords)
+{
+  memset(h,0,sizeof(*h));
+  h->magic=EVT_FILE_MAGIC;
+  h->version=EVT_FILE_VERSION;
+  h->hdr_size=sizeof(*h);
+  h->nch=SHWR_RAW_NCH_MAX;
+  h->nsamples=SHWR_NSAMPLES;
+  h->rd_nwords=rd_nwords;
+  h->size=sizeof(*h)+sizeof(uint32_t)*(h->nch*h->nsamples+h->rd_nwords);
+  if(evt!=NULL){
+    h->id=evt->id;
+    h->Evt_type_1=evt->Evt_type_1;
+    h->gps_second=evt->ev_gps_info.second;
+    h->gps_ticks=evt->ev_gps_info.ticks;
+    h->gps_nanosec=evt->ev_gps_info.nanosec;
+    h->pps_cal=evt->ev_gps_info.pps_cal;
+    h->trace_start=evt->trace_start;
+  }
+}
+
+/* the shower channels and the RD words in one packed block; -1 if it
+   does not get smaller (noise only traces), then they are kept raw */
+static int evt_file_write_packed(struct evt_file *f,
+				 const struct evt_file_hdr *h,
+				 const uint32_t *fadc_raw[],const uint32_t *rd)
+{
+  struct evt_file_hdr hp;
+  const uint32_t *src[SHWR_RAW_NCH_MAX+1];
+  int n[SHWR_RAW_NCH_MAX+1];
+  size_t bound,len;
+  void *p;
+  int i,narrays=0;
+
+  for(i=0;i<h->nch;i++){
+    src[narrays]=fadc_raw[i];
+    n[narrays++]=h->nsamples;
+  }
+  if(h->rd_nwords>0){
+    src[narrays]=rd;
+    n[narrays++]=h->rd_nwords;
+  }
+  bound=trace_pack_bound(narrays,
+			 (h->nsamples>h->rd_nwords) ? h->nsamples : h->rd_nwords);
+  if(bound>f->pack_size){
+    p=realloc(f->pack_buf,bound);
+    if(p==NULL)
+      return(1);
+    f->pack_buf=p;
+    f->pack_size=bound;
+  }
+  len=trace_pack(src,n,narrays,f->pack_buf,f->pack_size);
+  if(len==0)
+    return(1);
+  if(len>=h->size-sizeof(*h))
+    return(-1);
+  hp=*h;
+  hp.encoding=EVT_FILE_PACKED;
+  hp.size=sizeof(hp)+len;
+  if(fwrite(&hp,sizeof(hp),1,f->fp)!=1 ||
+     fwrite(f->pack_buf,1,len,f->fp)!=len)
+    return(1);
+  f->nraw+=h->size-sizeof(*h);
+  f->npacked+=len;
+  f->size+=hp.size;
+  f->nrecords++;
+  return(0);
+}
+
+int evt_file_write(struct evt_file *f,const struct evt_file_hdr *h,
+		   const uint32_t *fadc_raw[],const uint32_t *rd)
+{
+  int i,ret;
+
+  if(f->fp==NULL)
+    return(1);
+  if(f->max_size>0 && f->size>=f->max_size && evt_file_rotate(f)!=0)
+    return(1);
+  if(f->pack){
+    ret=evt_file_write_packed(f,h,fadc_raw,rd);
+    if(ret>=0)
+      return(ret);
+  }
+  if(fwrite(h,sizeof(*h),1,f->fp)!=1)
+    return(1);
+  for(i=0;i<h->nch;i++){
+    if(fwrite(fadc_raw[i],sizeof(uint32_t),h->nsamples,f->fp)!=h->nsamples)
+      return(1);
+  }
+  if(h->rd_nwords>0 &&
+     fwrite(rd,sizeof(uint32_t),h->rd_nwords,f->fp)!=h->rd_nwords)
+    return(1);
+  f->nraw+=h->size-sizeof(*h);
+  f->npacked+=h->size-sizeof(*h);
+  f->size+=h->size;
+  f->nrecords++;
+  return(0);
+}
+
+int evt_file_write_raw(struct evt_file *f,const struct shwr_evt_raw *evt,
+		       const uint32_t *rd,int rd_nwords,uint32_t flags)
+{
+  struct evt_file_hdr h;
+  const uint32_t *fadc_raw[SHWR_RAW_NCH_MAX];
+  int i;
+
+  if(rd==NULL){
+    evt_file_hdr_init(&h,evt,0);
+    h.flags|=EVT_FILE_RD_MISSING;
+  } else {
+    evt_file_hdr_init(&h,evt,rd_nwords);
+  }
+  h.flags|=flags;
+  for(i=0;i<SHWR_RAW_NCH_MAX;i++)
+    fadc_raw[i]=evt->fadc_raw[i];
+  return(evt_file_write(f,&h,fadc_raw,rd));
+}
+
+static int evt_file_read_packed(FILE *fp,const struct evt_file_hdr *h,
+				uint32_t fadc_raw[][SHWR_NSAMPLES],uint32_t *rd)
+{
+  static uint8_t *buf=NULL;
+  static size_t buf_size=0;
+  size_t len;
+  void *p;
+  int i;
+
+  if(h->size<h->hdr_size)
+    return(1);
+  len=h->size-h->hdr_size;
+  if(len>buf_size){
+    p=realloc(buf,len);
+    if(p==NULL)
+      return(1);
+    buf=p;
+    buf_size=len;
+  }
+  if(fread(buf,1,len,fp)!=len)
+    return(1);
+  if(trace_pack_narrays(buf,len)!=h->nch+(h->rd_nwords>0)){
+    printf("evt_file: record %u: bad packed data\n",h->id);
+    return(1);
+  }
+  for(i=0;i<h->nch;i++){
+    if(trace_unpack(buf,len,i,fadc_raw[i],h->nsamples)!=h->nsamples)
+      break;
+  }
+  if(i==h->nch && (h->rd_nwords==0 ||
+		   trace_unpack(buf,len,i,rd,h->rd_nwords)==h->rd_nwords))
+    return(0);
+  printf("evt_file: record %u: bad packed data\n",h->id);
+  return(1);
+}
+
+int evt_file_read(FILE *fp,struct evt_file_hdr *h,
+		  uint32_t fadc_raw[][SHWR_NSAMPLES],uint32_t *rd,int rd_max)
+{
+  size_t len;
+  long skip;
+  int i;
+
+  memset(h,0,sizeof(*h));
+  if(fread(h,EVT_FILE_HDR_V1_SIZE,1,fp)!=1)
+    return(feof(fp) ? -1 : 1);
+  if(h->magic!=EVT_FILE_MAGIC){
+    printf("evt_file: bad record magic %08x\n",h->magic);
+    return(1);
+  }
+  if(h->nch>SHWR_RAW_NCH_MAX || h->nsamples!=SHWR_NSAMPLES ||
+     h->rd_nwords>rd_max || h->hdr_size<EVT_FILE_HDR_V1_SIZE){
+    printf("evt_file: record %u does not fit (%d ch, %d samples, %d rd)\n",
+	   h->id,h->nch,h->nsamples,h->rd_nwords);
+    return(1);
+  }
+  /* the rest of the header: older writers have a smaller one (the
+     new fields stay 0), newer writers may have a bigger one */
+  len=(h->hdr_size<sizeof(*h)) ? h->hdr_size : sizeof(*h);
+  if(len>EVT_FILE_HDR_V1_SIZE &&
+     fread((char *)h+EVT_FILE_HDR_V1_SIZE,len-EVT_FILE_HDR_V1_SIZE,1,fp)!=1)
+    return(1);
+  if(h->hdr_size>sizeof(*h) &&
+     fseek(fp,h->hdr_size-sizeof(*h),SEEK_CUR)!=0)
+    return(1);
+  if(h->encoding==EVT_FILE_PACKED)
+    return(evt_file_read_packed(fp,h,fadc_raw,rd));
+  if(h->encoding!=EVT_FILE_RAW){
+    printf("evt_file: record %u has an unknown encoding %d\n",h->id,
+	   h->encoding);
+    return(1);
+  }
+  for(i=0;i<h->nch;i++){
+    if(fread(fadc_raw[i],sizeof(uint32_t),h->nsamples,fp)!=h->nsamples)
+      return(1);
+  }
+  if(h->rd_nwords>0 &&
+     fread(rd,sizeof(uint32_t),h->rd_nwords,fp)!=h->rd_nwords)
+    return(1);
+  skip=(long)h->size-h->hdr_size-
+    sizeof(uint32_t)*(h->nch*h->nsamples+h->rd_nwords);
+  if(skip>0 && fseek(fp,skip,SEEK_CUR)!=0)
+    return(1);
+  return(0);
+}
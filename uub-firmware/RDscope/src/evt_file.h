@@ -0,0 +1,135 @@
+/* Binary event records written by the scope.
+
+   Each record is a struct evt_file_hdr followed by the raw shower
+   words (nch blocks of nsamples uint32_t, as in shwr_evt_raw.fadc_raw,
+   not rotated by trace_start) and rd_nwords raw RD words. Everything
+   is stored in the UUB (little endian) byte order. Records are simply
+   appended one after the other; hdr.size allows to skip a record
+   without knowing its contents.
+
+   With hdr.encoding EVT_FILE_PACKED (version 2) the words are stored
+   compressed with trace_pack.h instead: the shower channels and then
+   the RD words as the arrays of one packed block, hdr.size-hdr_size
+   bytes. evt_file_read gives them back unpacked either way.
+
+   evt2json converts records to the JSON the scope web page reads.
+*/
+
+#ifndef _EVT_FILE_H
+#define _EVT_FILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "shwr_evt_defs.h"
+
+#define EVT_FILE_MAGIC 0x56454452 /* "RDEV" */
+#define EVT_FILE_VERSION 3
+#define EVT_FILE_BUFSIZE (256*1024)
+
+#define EVT_FILE_RD_MISSING 1 /* flags: the RD data is not valid */
+#define EVT_FILE_RD_PARITY 2  /* flags: RD parity errors over the budget */
+
+#define EVT_FILE_RAW 0        /* encoding: the words as they are */
+#define EVT_FILE_PACKED 1     /* encoding: trace_pack.h */
+
+struct evt_file_hdr
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t hdr_size;   /* sizeof(struct evt_file_hdr) of the writer */
+  uint32_t size;       /* whole record size, header included */
+  uint32_t id;
+  uint32_t Evt_type_1;
+  uint32_t gps_second;
+  uint32_t gps_ticks;
+  int32_t trace_start;
+  uint32_t flags;
+  uint16_t nch;        /* raw channels (2 ADC per word) */
+  uint16_t nsamples;
+  uint16_t rd_nwords;
+  uint16_t encoding;   /* EVT_FILE_RAW or EVT_FILE_PACKED (0 in version 1) */
+  /* version 3: the time tag calibrated with the PPS (ttag_cal.h); 0 when
+     read from an older record */
+  uint32_t gps_nanosec;
+  uint32_t pps_cal;    /* clock ticks of the second, 0: not reliable */
+};
+
+/* the header of the versions 1 and 2 */
+#define EVT_FILE_HDR_V1_SIZE offsetof(struct evt_file_hdr,gps_nanosec)
+
+struct evt_file
+{
+  FILE *fp;
+  char *buf;
+  char path[256];
+  uint64_t size;      /* bytes in the file */
+  uint64_t max_size;  /* 0: no limit */
+  uint32_t nrotate;
+  uint32_t nrecords;
+  int pack;           /* write the records with EVT_FILE_PACKED */
+  void *pack_buf;
+  size_t pack_size;
+  uint64_t nraw;      /* bytes of the words written, before packing */
+  uint64_t npacked;   /* ... and after */
+};
+
+int evt_file_open(struct evt_file *f,const char *path,int append);
+int evt_file_close(struct evt_file *f);
+int evt_file_flush(struct evt_file *f);
+void evt_file_set_pack(struct evt_file *f,int pack);
+/* once the file has max bytes (0: no limit) it is renamed to path.1,
+   replacing the previous one, and a new file is started */
+void evt_file_set_max_size(struct evt_file *f,uint64_t max);
+
+void evt_file_hdr_init(struct evt_file_hdr *h,
+		       const struct shwr_evt_raw *evt,int rd_nwords);
+int evt_file_write(struct evt_file *f,const struct evt_file_hdr *h,
+		   const uint32_t *fadc_raw[],const uint32_t *rd);
+/* rd NULL: no RD words, EVT_FILE_RD_MISSING set. flags: EVT_FILE_... */
+int evt_file_write_raw(struct evt_file *f,const struct shwr_evt_raw *evt,
+		       const uint32_t *rd,int rd_nwords,uint32_t flags);
+
+/* read the next record. fadc_raw must hold
+   SHWR_RAW_NCH_MAX*SHWR_NSAMPLES words and rd rd_max words.
+   return 0: ok, -1: end of file, >0: error */
+int evt_file_read(FILE *fp,struct evt_file_hdr *h,
+		  uint32_t fadc_raw[][SHWR_NSAMPLES],uint32_t *rd,int rd_max);
+
+/* JSON of an event for the scope web page (scope_rd_2.1.html), see
+   evt_json.c: EVT_JSON_LEGACY, an array of 2048 samples, or
+   EVT_JSON_COLUMNS, an array for each channel */
+#define EVT_JSON_LEGACY 0
+#define EVT_JSON_COLUMNS 1
+
+int evt_json_layout(const char *name); /* "legacy", "columns"; -1 */
+int evt_json_write(FILE *fp,const struct evt_file_hdr *h,
+		   const uint32_t fadc_raw[][SHWR_NSAMPLES],const uint32_t *rd);
+
+/* the part of the event the columns layout writes: channels, a window
+   of samples around the trigger and a decimation keeping the minimum
+   and maximum of each bin. The RD samples are taken at the same
+   indices as the shower ones. */
+#define EVT_JSON_RD0 10 /* channel numbers of the RD ADC */
+#define EVT_JSON_RD1 11
+#define EVT_JSON_NCH 12
+#define EVT_JSON_ALL ((1U<<EVT_JSON_NCH)-1)
+
+struct evt_json_sel
+{
+  uint32_t ch_mask; /* 1<<channel: 0..9 UUB ADC, EVT_JSON_RD0/1 */
+  int start;        /* first sample, from the trigger (SHWR_TRIG_DLY) */
+  int len;          /* samples */
+  int decim;        /* >1: minimum and maximum of bins of decim samples */
+};
+
+void evt_json_sel_all(struct evt_json_sel *s);
+/* "channels[:start:len[:decim]]", channels "all" or a list like
+   "0,1,rd0"; 1 if it is not valid */
+int evt_json_sel_parse(struct evt_json_sel *s,const char *spec);
+/* sel NULL: all */
+int evt_json_write_columns(FILE *fp,const struct evt_file_hdr *h,
+			   const uint32_t fadc_raw[][SHWR_NSAMPLES],
+			   const uint32_t *rd,const struct evt_json_sel *sel);
+
+#endif /*_EVT_FILE_H*/
@@ -0,0 +1,317 @@
+// JSON formatting of one event for the scope web page, in two layouts:
+//  - legacy: the one FeShwrRead_test used to print, an array of
+//    SHWR_NSAMPLES objects with the 10 UUB ADC, the 2 RD ADC and the RD
+//    parity check of each sample, all as strings. A sample is formatted
+//    in a local buffer and goes to the stream with a single fwrite.
+//  - columns: one object with the event header and one array of numbers
+//    for each channel; check0/check1 list the samples with a bad RD
+//    parity. About 4 times smaller. Formatted in a buffer which goes to
+//    the stream when it is full. Only the channels and the window of
+//    samples asked (struct evt_json_sel) are unpacked and decimated,
+//    then formatted: with a decimation each channel is the list of the
+//    minimum and maximum of each bin, one after the other.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sde_trigger_defs.h"
+#include "evt_file.h"
+#include "shwr_unpack.h"
+#include "rd_parity.h"
+
+#define JSON_BUF 8192
+
+static const char *layout_name[]={"legacy","columns"};
+
+static const char *adc_name[SHWR_NCH_MAX]={
+  "adc0","adc1","adc2","adc3","adc4","adc5","adc6","adc7","adc8","adc9"
+};
+
+static char *put_str(char *p,const char *s)
+{
+  while(*s)
+    *p++=*s++;
+  return(p);
+}
+
+static char *put_int(char *p,int v)
+{
+  char tmp[12];
+  int n=0;
+  unsigned int u;
+
+  if(v<0){
+    *p++='-';
+    u=-v;
+  } else {
+    u=v;
+  }
+  do {
+    tmp[n++]='0'+u%10;
+    u/=10;
+  } while(u);
+  while(n)
+    *p++=tmp[--n];
+  return(p);
+}
+
+/* "name": "value" */
+static char *put_field(char *p,const char *name,int v)
+{
+  *p++='"';
+  p=put_str(p,name);
+  p=put_str(p,"\": \"");
+  p=put_int(p,v);
+  *p++='"';
+  return(p);
+}
+
+int evt_json_write(FILE *fp,const struct evt_file_hdr *h,
+		   const uint32_t fadc_raw[][SHWR_NSAMPLES],const uint32_t *rd)
+{
+  uint16_t adc[SHWR_NCH_MAX][SHWR_NSAMPLES];
+  char line[512];
+  char *p;
+  int i,j;
+  uint32_t rdw,bad;
+  int16_t adc_rd0,adc_rd1;
+
+  for(i=0;i<h->nch;i++)
+    shwr_unpack_channel(fadc_raw[i],h->trace_start,adc[2*i],adc[2*i+1]);
+
+  if(fputc('[',fp)==EOF)
+    return(1);
+  for(j=0;j<h->nsamples;j++){
+    p=line;
+    *p++='{';
+    for(i=0;i<2*h->nch;i++){
+      p=put_field(p,adc_name[i],adc[i][j]);
+      p=put_str(p,", ");
+    }
+    rdw=(j<h->rd_nwords) ? rd[j] : 0;
+    adc_rd0=((int16_t)((rdw>>1) & 0xfff));
+    adc_rd1=((int16_t)((rdw>>17) & 0xfff));
+    p=put_field(p,"adc_rd0",(adc_rd0>2047) ? (adc_rd0-4096) : adc_rd0);
+    p=put_str(p,", ");
+    p=put_field(p,"adc_rd1",(adc_rd1>2047) ? (adc_rd1-4096) : adc_rd1);
+    p=put_str(p,", ");
+
+    /* odd parity: the parity bit complete a odd number of bits set */
+    bad=rd_parity_bad(rdw);
+    p=put_field(p,"check0",bad & 1);
+    p=put_str(p,", ");
+    p=put_field(p,"check1",bad>>16);
+    *p++='}';
+    if(j!=h->nsamples-1)
+      p=put_str(p,", ");
+    if(fwrite(line,1,p-line,fp)!=p-line)
+      return(1);
+  }
+  if(fputs("]\n",fp)==EOF)
+    return(1);
+  return(0);
+}
+
+int evt_json_layout(const char *name)
+{
+  int i;
+
+  for(i=0;i<(int)(sizeof(layout_name)/sizeof(layout_name[0]));i++){
+    if(strcmp(name,layout_name[i])==0)
+      return(i);
+  }
+  return(-1);
+}
+
+struct json_buf
+{
+  FILE *fp;
+  char *p;
+  int err;
+  char buf[JSON_BUF];
+};
+
+/* room for at least a field, or a number of an array */
+static void jb_room(struct json_buf *b)
+{
+  if(b->p-b->buf<JSON_BUF-64)
+    return;
+  if(fwrite(b->buf,1,b->p-b->buf,b->fp)!=b->p-b->buf)
+    b->err=1;
+  b->p=b->buf;
+}
+
+static void jb_uint(struct json_buf *b,const char *name,uint32_t v)
+{
+  char tmp[12];
+  int n=0;
+
+  jb_room(b);
+  b->p+=sprintf(b->p,",\"%s\":",name);
+  do {
+    tmp[n++]='0'+v%10;
+    v/=10;
+  } while(v);
+  while(n)
+    *b->p++=tmp[--n];
+}
+
+static void jb_array(struct json_buf *b,const char *name,const int16_t *v,
+		     int n)
+{
+  int j;
+
+  jb_room(b);
+  b->p+=sprintf(b->p,",\"%s\":[",name);
+  for(j=0;j<n;j++){
+    jb_room(b);
+    if(j>0)
+      *b->p++=',';
+    b->p=put_int(b->p,v[j]);
+  }
+  *b->p++=']';
+}
+
+void evt_json_sel_all(struct evt_json_sel *s)
+{
+  s->ch_mask=EVT_JSON_ALL;
+  s->start=-SHWR_TRIG_DLY;
+  s->len=SHWR_NSAMPLES;
+  s->decim=1;
+}
+
+int evt_json_sel_parse(struct evt_json_sel *s,const char *spec)
+{
+  char buf[128];
+  char *p,*tok,*save;
+  int ch,n;
+
+  evt_json_sel_all(s);
+  if(strlen(spec)>=sizeof(buf))
+    return(1);
+  strcpy(buf,spec);
+  p=strchr(buf,':');
+  if(p!=NULL){
+    *p++='\0';
+    n=sscanf(p,"%d:%d:%d",&s->start,&s->len,&s->decim);
+    if(n<2 || s->len<1 || s->decim<1)
+      return(1);
+  }
+  if(strcmp(buf,"all")==0)
+    return(0);
+  s->ch_mask=0;
+  for(tok=strtok_r(buf,",",&save);tok!=NULL;tok=strtok_r(NULL,",",&save)){
+    if(strcmp(tok,"rd0")==0)
+      ch=EVT_JSON_RD0;
+    else if(strcmp(tok,"rd1")==0)
+      ch=EVT_JSON_RD1;
+    else if(sscanf(tok,"%d%n",&ch,&n)!=1 || tok[n]!='\0' ||
+	    ch<0 || ch>=SHWR_NCH_MAX)
+      return(1);
+    s->ch_mask|=1U<<ch;
+  }
+  return(s->ch_mask==0);
+}
+
+/* minimum and maximum of each bin of d values; return the values out */
+static int decimate(int16_t *v,int n,int d)
+{
+  int16_t min,max;
+  int i,j,k=0;
+
+  if(d<=1)
+    return(n);
+  for(i=0;i<n;i+=d){
+    min=max=v[i];
+    for(j=i+1;j<i+d && j<n;j++){
+      if(v[j]<min)
+	min=v[j];
+      if(v[j]>max)
+	max=v[j];
+    }
+    v[k++]=min; /* k<=i: in place */
+    v[k++]=max;
+  }
+  return(k);
+}
+
+int evt_json_write_columns(FILE *fp,const struct evt_file_hdr *h,
+			   const uint32_t fadc_raw[][SHWR_NSAMPLES],
+			   const uint32_t *rd,const struct evt_json_sel *sel)
+{
+  struct evt_json_sel all;
+  struct json_buf b;
+  uint16_t lo[SHWR_NSAMPLES],hi[SHWR_NSAMPLES];
+  int16_t col[2*SHWR_NSAMPLES];
+  int16_t v;
+  uint32_t bad;
+  int i,j,k,n,first,last,nrd;
+
+  if(sel==NULL){
+    evt_json_sel_all(&all);
+    sel=&all;
+  }
+  /* the window, in the samples of the event */
+  first=SHWR_TRIG_DLY+sel->start;
+  last=first+sel->len;
+  if(first<0)
+    first=0;
+  if(last>h->nsamples)
+    last=h->nsamples;
+  if(last<first)
+    last=first;
+  n=last-first;
+  nrd=(h->rd_nwords<last) ? h->rd_nwords-first : n;
+  if(nrd<0)
+    nrd=0;
+
+  b.fp=fp;
+  b.err=0;
+  b.p=b.buf;
+  b.p+=sprintf(b.p,"{\"id\":%u",h->id);
+  jb_uint(&b,"gps_second",h->gps_second);
+  jb_uint(&b,"gps_nanosec",h->gps_nanosec);
+  jb_uint(&b,"trace_start",h->trace_start);
+  jb_uint(&b,"flags",h->flags);
+  jb_uint(&b,"first",first);
+  jb_uint(&b,"nsamples",n);
+  jb_uint(&b,"decim",(sel->decim>1) ? sel->decim : 1);
+  for(i=0;i<h->nch;i++){
+    if(!((sel->ch_mask>>(2*i)) & 3))
+      continue;
+    shwr_unpack_window(fadc_raw[i],h->trace_start,first,n,lo,hi);
+    for(k=0;k<2;k++){
+      if(!((sel->ch_mask>>(2*i+k)) & 1))
+	continue;
+      for(j=0;j<n;j++)
+	col[j]=k ? hi[j] : lo[j];
+      jb_array(&b,adc_name[2*i+k],col,decimate(col,n,sel->decim));
+    }
+  }
+  /* RD: 12 bits signed samples, then the parity */
+  for(k=0;k<2;k++){
+    if(!((sel->ch_mask>>(EVT_JSON_RD0+k)) & 1))
+      continue;
+    for(j=0;j<nrd;j++){
+      v=(rd[first+j]>>(16*k+1)) & 0xfff;
+      col[j]=(v>2047) ? v-4096 : v;
+    }
+    jb_array(&b,k ? "adc_rd1" : "adc_rd0",col,decimate(col,nrd,sel->decim));
+  }
+  for(k=0;k<2;k++){
+    if(!((sel->ch_mask>>(EVT_JSON_RD0+k)) & 1))
+      continue;
+    for(i=j=0;j<nrd;j++){
+      bad=rd_parity_bad(rd[first+j]);
+      if((bad>>(16*k)) & 1)
+	col[i++]=first+j;
+    }
+    jb_array(&b,k ? "check1" : "check0",col,i);
+  }
+  *b.p++='}';
+  *b.p++='\n';
+  jb_room(&b);
+  if(fwrite(b.buf,1,b.p-b.buf,fp)!=b.p-b.buf)
+    b.err=1;
+  return(b.err);
+}
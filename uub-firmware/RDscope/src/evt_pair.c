@@ -0,0 +1,137 @@
+#include <string.h>
+
+#include "evt_pair.h"
+
+void evt_pair_init(struct evt_pair *p,int rd_first)
+{
+  memset(p,0,sizeof(*p));
+  p->rd_next=rd_first;
+}
+
+int evt_pair_rd_update(struct evt_pair *p,uint32_t full,uint32_t second)
+{
+  struct evt_pair_rd *r;
+  int n=0;
+
+  while(p->rd_count<EVT_PAIR_NBUF &&
+	((full>>p->rd_next) & 1) && !((p->rd_held>>p->rd_next) & 1)){
+    r=&p->rd[(p->rd_head+p->rd_count)%EVT_PAIR_NBUF];
+    r->buf=p->rd_next;
+    r->seq=p->rd_seq++;
+    r->second=second;
+    p->rd_count++;
+    p->rd_next=(p->rd_next+1)%EVT_PAIR_NBUF;
+    n++;
+  }
+  if(n>0 && (full & ((1<<EVT_PAIR_NBUF)-1))==(1<<EVT_PAIR_NBUF)-1)
+    p->nrd_overrun++;
+  return(n);
+}
+
+static void rd_pop(struct evt_pair *p)
+{
+  p->rd_head=(p->rd_head+1)%EVT_PAIR_NBUF;
+  p->rd_count--;
+}
+
+/* an RD buffer of sequence seq is kept */
+static int rd_queued(const struct evt_pair *p,uint32_t seq)
+{
+  int i;
+
+  for(i=0;i<p->rd_count;i++){
+    if(p->rd[(p->rd_head+i)%EVT_PAIR_NBUF].seq==seq)
+      return(1);
+  }
+  return(0);
+}
+
+int evt_pair_match(struct evt_pair *p,uint32_t ctr,uint32_t second,
+		   int *rd_buf,int *drop,int *ndrop)
+{
+  struct evt_pair_rd *r;
+  uint32_t delta,exp;
+  int behind=0;
+
+  /* unwrap the shower event counter; 0 is taken as a full turn */
+  ctr&=EVT_PAIR_CTR_MASK;
+  if(p->shwr_valid){
+    delta=(ctr-p->shwr_ctr) & EVT_PAIR_CTR_MASK;
+    if(delta==0)
+      delta=EVT_PAIR_CTR_MASK+1;
+    p->shwr_seq+=delta;
+    p->nshwr_lost+=delta-1;
+  }
+  p->shwr_valid=1;
+  p->shwr_ctr=ctr;
+
+  *rd_buf=-1;
+  *ndrop=0;
+  while(p->rd_count>0){
+    r=&p->rd[p->rd_head];
+    if(r->second+EVT_PAIR_MAX_DT<second){
+      /* seen well before this trigger: it is not its RD */
+      drop[(*ndrop)++]=r->buf;
+      p->nrd_orphan++;
+      p->locked=0;
+      rd_pop(p);
+      continue;
+    }
+    if(!p->locked){
+      p->offset=r->seq-p->shwr_seq;
+      p->locked=1;
+      p->nlock++;
+    }
+    exp=p->shwr_seq+p->offset;
+    if((int32_t)(r->seq-exp)<0){
+      /* seen in the second of this trigger and no RD for it further
+	 on: the offset may be off by RD buffers the interface did not
+	 send. It is kept until the next trigger confirms it. */
+      if(r->second>=second && !behind && !rd_queued(p,exp)){
+	behind=1;
+	if(++p->nbehind<EVT_PAIR_RELOCK){
+	  p->behind_by=exp-r->seq;
+	  break;
+	}
+	/* confirmed: the older RD buffers are orphans from now on */
+	p->offset-=p->behind_by;
+	p->nbehind=0;
+	p->nlock++;
+	exp=p->shwr_seq+p->offset;
+	if(r->seq==exp)
+	  continue;
+      }
+      drop[(*ndrop)++]=r->buf;
+      p->nrd_orphan++;
+      rd_pop(p);
+      continue;
+    }
+    if(r->seq==exp){
+      *rd_buf=r->buf;
+      p->rd_held|=1<<r->buf;
+      p->npaired++;
+      p->nbehind=0;
+      rd_pop(p);
+      return(EVT_PAIR_OK);
+    }
+    break; /* the RD of this trigger was lost or is late */
+  }
+  if(!behind)
+    p->nbehind=0;
+  p->nshwr_orphan++;
+  return(EVT_PAIR_NO_RD);
+}
+
+void evt_pair_rd_done(struct evt_pair *p,int rd_buf)
+{
+  if(rd_buf>=0)
+    p->rd_held&=~(1<<rd_buf);
+}
+
+void evt_pair_print(FILE *fp,const struct evt_pair *p)
+{
+  fprintf(fp,"RD pairing: %u paired, %u RD orphans, %u shower without RD,"
+	  " %u shower triggers lost, %u locks, %u RD overruns\n",
+	  p->npaired,p->nrd_orphan,p->nshwr_orphan,p->nshwr_lost,p->nlock,
+	  p->nrd_overrun);
+}
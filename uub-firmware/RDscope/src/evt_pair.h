@@ -0,0 +1,92 @@
+/* Pairing of the shower and RD buffers.
+
+   The two interfaces fill their buffers independently; the RD side
+   has no event number of its own. Each RD buffer gets a sequence
+   number in the order it was filled and the PPS second when it was
+   seen full. Each shower event gets a sequence number unwrapped from
+   its time tag event counter (TTAG_EVTCTR, 4 bits), so the shower
+   triggers which were not stored are counted too. Once locked, a
+   shower event goes with the RD buffer of sequence shower seq+offset:
+     - RD buffers older than that are orphans (their shower was lost,
+       or the RD of a shower event came too late),
+     - a newer RD buffer, or none at all, means the RD of this trigger
+       was lost or is late,
+     - an RD buffer seen more than EVT_PAIR_MAX_DT seconds before the
+       shower time is an orphan and the offset is locked again.
+   A trigger the RD interface did not send moves the offset by one: the
+   RD buffers then look older than expected. The offset is moved back
+   only when this is confirmed: EVT_PAIR_RELOCK shower events in a row
+   found RD buffers older than expected, seen full in their own PPS
+   second or later (not left over from a past second), and none of the
+   expected sequence. Until then the older RD buffer is kept, not
+   dropped. A single late RD buffer is only an orphan. Up to RD_MEM_NBUF RD buffers are
+   kept unmatched; when all of them were found full it is counted as an
+   overrun.
+*/
+
+#ifndef _EVT_PAIR_H
+#define _EVT_PAIR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define EVT_PAIR_NBUF 4   /* RD_MEM_NBUF */
+#define EVT_PAIR_MAX_DT 1 /* seconds */
+#define EVT_PAIR_RELOCK 2 /* shower events with older RD to lock again */
+#define EVT_PAIR_CTR_MASK 0xf
+
+/* evt_pair_match results */
+#define EVT_PAIR_OK 0
+#define EVT_PAIR_NO_RD 1  /* no RD buffer for this shower event */
+
+struct evt_pair_rd
+{
+  int buf;
+  uint32_t seq;
+  uint32_t second; /* PPS second when it was seen full */
+};
+
+struct evt_pair
+{
+  struct evt_pair_rd rd[EVT_PAIR_NBUF];
+  int rd_head;
+  int rd_count;
+  int rd_next;     /* next RD buffer to be filled */
+  uint32_t rd_seq; /* sequence of the next RD buffer */
+  uint32_t rd_held;/* paired buffers not given back yet (bits) */
+
+  int shwr_valid;
+  uint32_t shwr_ctr;
+  uint32_t shwr_seq;
+
+  int locked;
+  uint32_t offset; /* RD seq - shower seq */
+  int nbehind;     /* shower events in a row with older RD buffers */
+  uint32_t behind_by; /* ... and how much older at the first one */
+
+  uint32_t npaired;
+  uint32_t nrd_orphan;   /* RD buffers without shower event */
+  uint32_t nshwr_orphan; /* shower events without RD */
+  uint32_t nshwr_lost;   /* shower triggers not stored (counter gaps) */
+  uint32_t nlock;        /* offset (re)locks */
+  uint32_t nrd_overrun;  /* all the RD buffers were full */
+};
+
+void evt_pair_init(struct evt_pair *p,int rd_first);
+
+/* record the RD buffers filled since the last call; full is the
+   RD_BUF_FULL bits. Return the number of new buffers. */
+int evt_pair_rd_update(struct evt_pair *p,uint32_t full,uint32_t second);
+
+/* pair a shower event (time tag event counter and second). *rd_buf is
+   the paired RD buffer; the RD buffers in drop[] (*ndrop of them, up to
+   EVT_PAIR_NBUF) are orphans to give back. */
+int evt_pair_match(struct evt_pair *p,uint32_t ctr,uint32_t second,
+		   int *rd_buf,int *drop,int *ndrop);
+
+/* the paired RD buffer was given back to the interface */
+void evt_pair_rd_done(struct evt_pair *p,int rd_buf);
+
+void evt_pair_print(FILE *fp,const struct evt_pair *p);
+
+#endif /*_EVT_PAIR_H*/
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "evt_pub.h"
+
+static uint64_t pub_now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return((uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec);
+}
+
+int evt_pub_init(struct evt_pub *p,const char *path,int layout,
+		 const struct evt_json_sel *sel,uint32_t min_ms)
+{
+  memset(p,0,sizeof(*p));
+  if(strlen(path)>=sizeof(p->path)){
+    printf("evt_pub: %s: name too long\n",path);
+    return(1);
+  }
+  strcpy(p->path,path);
+  snprintf(p->tmp,sizeof(p->tmp),"%s.tmp",path);
+  p->layout=layout;
+  if(sel!=NULL)
+    p->sel=*sel;
+  else
+    evt_json_sel_all(&p->sel);
+  p->min_ms=min_ms;
+  p->buf=malloc(EVT_PUB_BUFSIZE);
+  pthread_mutex_init(&p->lock,NULL);
+  return(0);
+}
+
+void evt_pub_end(struct evt_pub *p)
+{
+  unlink(p->tmp);
+  free(p->buf);
+  p->buf=NULL;
+  pthread_mutex_destroy(&p->lock);
+}
+
+int evt_pub_claim(struct evt_pub *p)
+{
+  if(pthread_mutex_trylock(&p->lock)!=0){
+    __sync_fetch_and_add(&p->nskip,1);
+    return(0);
+  }
+  if(p->npub!=0 && pub_now()-p->t_last<p->min_ms*1000000ULL){
+    __sync_fetch_and_add(&p->nskip,1);
+    pthread_mutex_unlock(&p->lock);
+    return(0);
+  }
+  return(1);
+}
+
+int evt_pub_write(struct evt_pub *p,const struct evt_file_hdr *h,
+		  const uint32_t fadc_raw[][SHWR_NSAMPLES],const uint32_t *rd)
+{
+  FILE *fp;
+  int ret;
+
+  fp=fopen(p->tmp,"w");
+  if(fp==NULL){
+    if(p->nerr++==0)
+      printf("evt_pub: not possible to open %s: %s\n",p->tmp,
+	     strerror(errno));
+    pthread_mutex_unlock(&p->lock);
+    return(1);
+  }
+  if(p->buf!=NULL)
+    setvbuf(fp,p->buf,_IOFBF,EVT_PUB_BUFSIZE);
+  if(p->layout==EVT_JSON_COLUMNS)
+    ret=evt_json_write_columns(fp,h,fadc_raw,rd,&p->sel);
+  else
+    ret=evt_json_write(fp,h,fadc_raw,rd);
+  ret|=(fclose(fp)!=0);
+  if(ret==0 && rename(p->tmp,p->path)!=0)
+    ret=1;
+  if(ret==0){
+    p->npub++;
+    p->t_last=pub_now();
+  } else {
+    p->nerr++;
+  }
+  pthread_mutex_unlock(&p->lock);
+  return(ret);
+}
+
+void evt_pub_print(FILE *fp,const struct evt_pub *p)
+{
+  fprintf(fp,"JSON %s: %u published, %u skipped, %u errors\n",p->path,
+	  p->npub,p->nskip,p->nerr);
+}
@@ -0,0 +1,54 @@
+/* Publication of the last event as JSON for the scope web page.
+
+   The event is written to a temporary file next to the published one
+   and renamed over it, so the page always reads a whole event, the old
+   one or the new one, never a file being written. Publications closer
+   than min_ms to the last one are skipped, and so is an event which
+   comes while another writer thread is publishing: the acquisition
+   never waits for the web page.
+*/
+
+#ifndef _EVT_PUB_H
+#define _EVT_PUB_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "evt_file.h"
+
+#define EVT_PUB_MIN_MS 250
+#define EVT_PUB_BUFSIZE (64*1024)
+
+struct evt_pub
+{
+  char path[256];
+  char tmp[272];      /* path.tmp, in the same file system */
+  int layout;         /* EVT_JSON_LEGACY or EVT_JSON_COLUMNS */
+  struct evt_json_sel sel; /* ... what of the event the columns have */
+  uint32_t min_ms;
+  uint64_t t_last;    /* CLOCK_MONOTONIC ns of the last one, under lock */
+  pthread_mutex_t lock; /* held from evt_pub_claim to evt_pub_write */
+  char *buf;          /* stdio buffer of the temporary file */
+
+  uint32_t npub;
+  uint32_t nskip;     /* too early, or busy */
+  uint32_t nerr;
+};
+
+/* sel NULL: the whole event */
+int evt_pub_init(struct evt_pub *p,const char *path,int layout,
+		 const struct evt_json_sel *sel,uint32_t min_ms);
+void evt_pub_end(struct evt_pub *p);
+
+/* cheap check, before building the header of the event. 1: the event
+   is due and the caller has the publication, to be given back by
+   evt_pub_write; 0: too early or busy, counted as skipped */
+int evt_pub_claim(struct evt_pub *p);
+/* only after a successful evt_pub_claim. 0: published, 1: error */
+int evt_pub_write(struct evt_pub *p,const struct evt_file_hdr *h,
+		  const uint32_t fadc_raw[][SHWR_NSAMPLES],const uint32_t *rd);
+
+void evt_pub_print(FILE *fp,const struct evt_pub *p);
+
+#endif /*_EVT_PUB_H*/
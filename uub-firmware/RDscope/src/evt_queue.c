@@ -0,0 +1,53 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "evt_queue.h"
+
+int evt_queue_init(struct evt_queue *q,unsigned int depth)
+{
+  memset(q,0,sizeof(*q));
+  if(depth==0 || (depth & (depth-1))!=0)
+    return(1);
+  q->slot=malloc(depth*sizeof(struct evt_slot));
+  if(q->slot==NULL)
+    return(1);
+  q->mask=depth-1;
+  return(0);
+}
+
+void evt_queue_free(struct evt_queue *q)
+{
+  free(q->slot);
+  q->slot=NULL;
+}
+
+struct evt_slot *evt_queue_claim(struct evt_queue *q)
+{
+  unsigned int tail;
+
+  tail=__atomic_load_n(&q->tail,__ATOMIC_ACQUIRE);
+  if(q->head-tail>q->mask)
+    return(NULL);
+  return(&q->slot[q->head & q->mask]);
+}
+
+void evt_queue_push(struct evt_queue *q)
+{
+  /* the slot contents must be visible before the new head */
+  __atomic_store_n(&q->head,q->head+1,__ATOMIC_RELEASE);
+}
+
+struct evt_slot *evt_queue_peek(struct evt_queue *q)
+{
+  unsigned int head;
+
+  head=__atomic_load_n(&q->head,__ATOMIC_ACQUIRE);
+  if(head==q->tail)
+    return(NULL);
+  return(&q->slot[q->tail & q->mask]);
+}
+
+void evt_queue_pop(struct evt_queue *q)
+{
+  __atomic_store_n(&q->tail,q->tail+1,__ATOMIC_RELEASE);
+}
@@ -0,0 +1,47 @@
+/* Bounded lock-free queue of events between one producer (the
+   acquisition, which drains the FPGA buffers) and one consumer (a
+   writer). The slots are allocated once; the producer fills the slot
+   given by evt_queue_claim and publish it with evt_queue_push, the
+   consumer gets it with evt_queue_peek and gives it back with
+   evt_queue_pop. head is only written by the producer and tail only
+   by the consumer.
+*/
+
+#ifndef _EVT_QUEUE_H
+#define _EVT_QUEUE_H
+
+#include <stdint.h>
+#include "read_evt.h"
+
+#define EVT_QUEUE_DEPTH 16 /* power of 2 */
+
+struct evt_slot
+{
+  struct shwr_evt_raw evt;
+  uint32_t rd[RD_MEM_WORDS];
+  uint32_t seq;   /* acquisition order */
+  int rd_buf;
+  uint32_t rd_status;
+  uint32_t flags; /* EVT_LEASE_RD_MISSING */
+};
+
+struct evt_queue
+{
+  struct evt_slot *slot;
+  unsigned int mask;
+  unsigned int head; /* next slot to fill (producer) */
+  unsigned int tail; /* next slot to read (consumer) */
+};
+
+int evt_queue_init(struct evt_queue *q,unsigned int depth);
+void evt_queue_free(struct evt_queue *q);
+
+/* producer side */
+struct evt_slot *evt_queue_claim(struct evt_queue *q); /* NULL: full */
+void evt_queue_push(struct evt_queue *q);
+
+/* consumer side */
+struct evt_slot *evt_queue_peek(struct evt_queue *q);  /* NULL: empty */
+void evt_queue_pop(struct evt_queue *q);
+
+#endif /*_EVT_QUEUE_H*/
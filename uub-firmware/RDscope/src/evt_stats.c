@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "evt_stats.h"
+
+static const char *phase_name[EVT_PH_N]={
+  "wait","shwr copy","rd busy","rd copy","release","readout"
+};
+
+uint64_t evt_stats_now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return((uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec);
+}
+
+void evt_stats_reset(struct evt_stats *s)
+{
+  int enabled=s->enabled;
+
+  memset(s,0,sizeof(*s));
+  s->enabled=enabled;
+  s->start_ns=evt_stats_now();
+}
+
+void evt_stats_add(struct evt_stats *s,int phase,uint64_t ns)
+{
+  int bin=0;
+
+  s->count[phase]++;
+  s->sum_ns[phase]+=ns;
+  if(ns>s->max_ns[phase])
+    s->max_ns[phase]=ns;
+  while((ns>>=1)!=0 && bin<EVT_STATS_NBINS-1)
+    bin++;
+  s->hist[phase][bin]++;
+}
+
+void evt_stats_sample(struct evt_stats *s,uint32_t dead_ctr,int nfull)
+{
+  if(s->nevts==0)
+    s->dead_first=dead_ctr;
+  s->dead_last=dead_ctr;
+  if(nfull>SHWR_MEM_NBUF)
+    nfull=SHWR_MEM_NBUF;
+  s->nfull[nfull]++;
+  s->nevts++;
+}
+
+void evt_stats_print(FILE *fp,const struct evt_stats *s)
+{
+  double elapsed;
+  int i,b,last;
+
+  elapsed=(evt_stats_now()-s->start_ns)*1e-9;
+  fprintf(fp,"readout stats: %u events in %.3f s (%.1f evt/s)\n",
+	  s->nevts,elapsed,elapsed>0 ? s->nevts/elapsed : 0.);
+  fprintf(fp,"  dead time counter: %u (first %u, last %u)\n",
+	  s->dead_last-s->dead_first,s->dead_first,s->dead_last);
+  fprintf(fp,"  full shower buffers when read:");
+  for(i=0;i<=SHWR_MEM_NBUF;i++)
+    fprintf(fp," %d:%u",i,s->nfull[i]);
+  fprintf(fp,"\n");
+  for(i=0;i<EVT_PH_N;i++){
+    if(s->count[i]==0)
+      continue;
+    fprintf(fp,"  %-9s n=%u mean=%.1f us max=%.1f us\n",phase_name[i],
+	    s->count[i],s->sum_ns[i]*1e-3/s->count[i],s->max_ns[i]*1e-3);
+    for(last=EVT_STATS_NBINS-1;last>0 && s->hist[i][last]==0;last--);
+    fprintf(fp,"    log2(ns):");
+    for(b=0;b<=last;b++){
+      if(s->hist[i][b]!=0)
+	fprintf(fp," %d:%u",b,s->hist[i][b]);
+    }
+    fprintf(fp,"\n");
+  }
+}
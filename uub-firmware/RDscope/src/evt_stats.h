@@ -0,0 +1,47 @@
+/* Readout instrumentation: latency of each phase of the event readout
+   (read_evt_lease/read_evt_lease_copy/read_evt_release), measured with
+   CLOCK_MONOTONIC and kept as log2 histograms, and the hardware dead
+   time counter and number of full shower buffers seen at each event.
+*/
+
+#ifndef _EVT_STATS_H
+#define _EVT_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sde_trigger_defs.h"
+
+enum{
+  EVT_PH_WAIT=0,   /* waiting for a full shower buffer */
+  EVT_PH_SHWR_COPY,/* copy of the shower memories */
+  EVT_PH_RD_BUSY,  /* waiting for the RD transfer (RD_BUF_BUSY) */
+  EVT_PH_RD_COPY,  /* copy of the RD memory */
+  EVT_PH_RELEASE,  /* buffers given back to the FPGA */
+  EVT_PH_READOUT,  /* from the end of the wait to the release */
+  EVT_PH_N
+};
+
+#define EVT_STATS_NBINS 32 /* bin i: [2^i,2^(i+1)) ns */
+
+struct evt_stats
+{
+  int enabled;
+  uint64_t start_ns;
+  uint32_t count[EVT_PH_N];
+  uint64_t sum_ns[EVT_PH_N];
+  uint64_t max_ns[EVT_PH_N];
+  uint32_t hist[EVT_PH_N][EVT_STATS_NBINS];
+
+  /* sampled at each event */
+  uint32_t nevts;
+  uint32_t dead_first,dead_last; /* TTAG_DEAD_CTR_ADDR */
+  uint32_t nfull[SHWR_MEM_NBUF+1];/* SHWR_BUF_NFULL when the event was read */
+};
+
+uint64_t evt_stats_now();
+void evt_stats_reset(struct evt_stats *s);
+void evt_stats_add(struct evt_stats *s,int phase,uint64_t ns);
+void evt_stats_sample(struct evt_stats *s,uint32_t dead_ctr,int nfull);
+void evt_stats_print(FILE *fp,const struct evt_stats *s);
+
+#endif /*_EVT_STATS_H*/
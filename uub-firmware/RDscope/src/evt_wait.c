@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include "xparameters.h"
+#include "sde_trigger_defs.h"
+#include "evt_wait.h"
+
+/*please do not use the signal SIGRTMIN+15 because it will probaly be
+  used in other part of the code ...*/
+#define SIG_WAKEUP SIGRTMIN+14
+
+#define SHWR_INTR_MASK (1<<SHWR_TRIGGER_INTR_BIT)
+
+/* ---------------- periodical signal (polling) ---------------- */
+
+static int timer_open(struct evt_wait *w,const char *dev)
+{
+  struct sigevent sev;
+  struct itimerspec ts;
+
+  //signal of alarm handler - it is going to be just blocked to be used
+  //with sigwaitinfo system call.
+  if(sigemptyset(&w->sigset)!=0 ||
+     sigaddset(&w->sigset,SIG_WAKEUP)!=0 ||
+     sigprocmask(SIG_BLOCK,&w->sigset,NULL)!=0){
+    printf("error while trying to set signals ...\n");
+    return(1);
+  }
+
+  // periodical signal generation
+  memset(&sev,0,sizeof(sev));
+  sev.sigev_notify=SIGEV_SIGNAL;
+  sev.sigev_signo=SIG_WAKEUP;
+  if(timer_create(CLOCK_MONOTONIC,&sev,&w->t_alarm)!=0){
+    printf("timer creation error\n");
+    return(1);
+  }
+  w->timer_ok=1;
+  ts.it_interval.tv_sec=0;
+  ts.it_interval.tv_nsec=EVT_WAIT_TIMER_NS;
+  ts.it_value.tv_sec=0;
+  ts.it_value.tv_nsec=EVT_WAIT_TIMER_NS;
+  if(timer_settime(w->t_alarm,0,&ts,NULL)!=0){
+    printf("timer settime error\n");
+    return(1);
+  }
+  return(0);
+}
+
+static int timer_arm(struct evt_wait *w)
+{
+  return(0);
+}
+
+static int timer_wait(struct evt_wait *w)
+{
+  return(sigwaitinfo(&w->sigset,NULL)==SIG_WAKEUP ? 0 : 1);
+}
+
+static void timer_close(struct evt_wait *w)
+{
+  if(w->timer_ok){
+    timer_delete(w->t_alarm);
+    w->timer_ok=0;
+  }
+}
+
+/* ---------------- shower trigger interrupt through UIO ---------------- */
+
+static int uio_open(struct evt_wait *w,const char *dev)
+{
+  if(dev==NULL)
+    dev=EVT_WAIT_UIO_DEV;
+  w->fd=open(dev,O_RDWR);
+  if(w->fd<0){
+    printf("Error - it was not possible to open %s: %s\n",
+	   dev,strerror(errno));
+    return(1);
+  }
+  /* map 0 of the UIO device is the sde_trigger interrupt block */
+  w->intr_size=sysconf(_SC_PAGE_SIZE);
+  w->intr_regs=(uint32_t *)mmap(NULL,w->intr_size,
+				PROT_READ | PROT_WRITE,MAP_SHARED,
+				w->fd,0);
+  if(w->intr_regs==MAP_FAILED){
+    printf("Error - while trying to map the interrupt registers of %s\n",
+	   dev);
+    w->intr_regs=NULL;
+    return(1);
+  }
+  SDE_TRIGGER_ACK((void *)w->intr_regs,SHWR_INTR_MASK);
+  SDE_TRIGGER_EnableInterrupts((void *)w->intr_regs,SHWR_INTR_MASK);
+  return(0);
+}
+
+static int uio_arm(struct evt_wait *w)
+{
+  int32_t unmask=1;
+
+  /* clear the trigger interrupt and re-enable it in the kernel. The
+     caller re-check the buffer status after this, so an event which
+     arrives between the check and the read is not lost.
+  */
+  SDE_TRIGGER_ACK((void *)w->intr_regs,SHWR_INTR_MASK);
+  if(write(w->fd,&unmask,sizeof(unmask))!=sizeof(unmask))
+    return(1);
+  return(0);
+}
+
+static int uio_wait(struct evt_wait *w)
+{
+  uint32_t count;
+
+  if(read(w->fd,&count,sizeof(count))!=sizeof(count))
+    return(1); /* EINTR included */
+  return(0);
+}
+
+static void uio_close(struct evt_wait *w)
+{
+  if(w->intr_regs!=NULL){
+    SDE_TRIGGER_EnableInterrupts((void *)w->intr_regs,0);
+    munmap((void *)w->intr_regs,w->intr_size);
+    w->intr_regs=NULL;
+  }
+}
+
+/* ---------------- eventfd stand-in ---------------- */
+
+static int efd_open(struct evt_wait *w,const char *dev)
+{
+  w->fd=eventfd(0,0);
+  if(w->fd<0){
+    printf("Error - eventfd: %s\n",strerror(errno));
+    return(1);
+  }
+  return(0);
+}
+
+static int efd_arm(struct evt_wait *w)
+{
+  return(0);
+}
+
+static int efd_wait(struct evt_wait *w)
+{
+  uint64_t count;
+
+  if(read(w->fd,&count,sizeof(count))!=sizeof(count))
+    return(1);
+  return(0);
+}
+
+static void efd_close(struct evt_wait *w)
+{
+}
+
+static const struct evt_wait_ops wait_ops[EVT_WAIT_NTYPES]={
+  {"timer",  timer_open,timer_arm,timer_wait,timer_close},
+  {"uio",    uio_open,  uio_arm,  uio_wait,  uio_close},
+  {"eventfd",efd_open,  efd_arm,  efd_wait,  efd_close}
+};
+
+int evt_wait_type(const char *name)
+{
+  int i;
+
+  for(i=0;i<EVT_WAIT_NTYPES;i++){
+    if(strcmp(name,wait_ops[i].name)==0)
+      return(i);
+  }
+  return(-1);
+}
+
+int evt_wait_open(struct evt_wait *w,int type,const char *dev)
+{
+  memset(w,0,sizeof(*w));
+  w->fd=-1;
+  if(type<0 || type>=EVT_WAIT_NTYPES){
+    printf("evt_wait: unknown wait type %d\n",type);
+    return(1);
+  }
+  w->ops=&wait_ops[type];
+  if(w->ops->open(w,dev)!=0){
+    evt_wait_close(w);
+    return(1);
+  }
+  return(0);
+}
+
+int evt_wait_arm(struct evt_wait *w)
+{
+  return(w->ops->arm(w));
+}
+
+int evt_wait_wait(struct evt_wait *w)
+{
+  int ret;
+
+  ret=w->ops->wait(w);
+  if(ret==0)
+    w->nwakeups++;
+  return(ret);
+}
+
+int evt_wait_notify(struct evt_wait *w)
+{
+  uint64_t one=1;
+
+  if(w->ops!=&wait_ops[EVT_WAIT_EVENTFD])
+    return(1);
+  if(write(w->fd,&one,sizeof(one))!=sizeof(one))
+    return(1);
+  return(0);
+}
+
+void evt_wait_close(struct evt_wait *w)
+{
+  if(w->ops!=NULL)
+    w->ops->close(w);
+  if(w->fd>=0){
+    close(w->fd);
+    w->fd=-1;
+  }
+  w->ops=NULL;
+}
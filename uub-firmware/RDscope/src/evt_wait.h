@@ -0,0 +1,69 @@
+/* Wait backends used by read_evt_read to sleep until the shower
+   trigger has at least one full buffer.
+
+   EVT_WAIT_TIMER   - the original 100us periodical signal, the process
+                      wakes up and polls SHWR_BUF_STATUS_ADDR.
+   EVT_WAIT_UIO     - block on the shower trigger interrupt through a
+                      UIO device (SDE_TRIGGER_EnableInterrupts/ACK).
+   EVT_WAIT_EVENTFD - block on an eventfd. Nothing in the hardware
+                      signals it, it is a stand-in to exercise the
+                      interrupt driven path on a plain Linux box: some
+                      other thread call evt_wait_notify.
+
+   The caller always re-check the buffer status after evt_wait_arm, so
+   a backend may wake up spuriously without losing events.
+*/
+
+#ifndef _EVT_WAIT_H
+#define _EVT_WAIT_H
+
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+
+#define EVT_WAIT_UIO_DEV "/dev/uio0"
+#define EVT_WAIT_TIMER_NS 100000 /* .1 ms */
+
+enum{
+  EVT_WAIT_TIMER=0,
+  EVT_WAIT_UIO,
+  EVT_WAIT_EVENTFD,
+  EVT_WAIT_NTYPES
+};
+
+struct evt_wait;
+
+struct evt_wait_ops
+{
+  const char *name;
+  int (*open)(struct evt_wait *w,const char *dev);
+  int (*arm)(struct evt_wait *w);  /* get ready for the next wakeup */
+  int (*wait)(struct evt_wait *w); /* 0: woke up; otherwise interrupted */
+  void (*close)(struct evt_wait *w);
+};
+
+struct evt_wait
+{
+  const struct evt_wait_ops *ops;
+  int fd;
+
+  /* EVT_WAIT_TIMER */
+  sigset_t sigset;
+  timer_t t_alarm;
+  int timer_ok;
+
+  /* EVT_WAIT_UIO - interrupt registers of the sde_trigger */
+  uint32_t volatile *intr_regs;
+  int intr_size;
+
+  uint32_t nwakeups;
+};
+
+int evt_wait_type(const char *name);
+int evt_wait_open(struct evt_wait *w,int type,const char *dev);
+int evt_wait_arm(struct evt_wait *w);
+int evt_wait_wait(struct evt_wait *w);
+int evt_wait_notify(struct evt_wait *w);
+void evt_wait_close(struct evt_wait *w);
+
+#endif /*_EVT_WAIT_H*/
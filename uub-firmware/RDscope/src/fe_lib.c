@@ -0,0 +1,425 @@
+// Front-end library: SDE trigger configuration (fe_lib.h) over a
+// shadow copy of the trigger registers.
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "fe_lib.h"
+#include "xparameters.h"
+#include "sde_trigger_defs.h"
+#include "rd_dev.h"
+
+#define FE_PMT_MASK 0x7
+
+/*
+  ID: shower_trigger_reg     Begin
+  one entry for each FE_SHWR_TRIG_... in fe_lib.h (ID: shower_trigger),
+  in the same order. -1: the trigger has no such register.
+  The sde_trigger_defs.h gives the layout of the compatibility SB
+  enable register only: the TOT and TOTD PMT and coincidence settings
+  give FE_NOT_IMPLEMENTED until their fields are defined there.
+*/
+struct shwr_trig_reg
+{
+  uint32_t mask_bit;  /* in SHWR_BUF_TRIG_MASK_ADDR */
+  int th_addr;        /* first of the 3 threshold registers */
+  int enab_addr;
+  int pmt_shift;
+  int coinc_shift;
+  uint32_t coinc_mask;
+};
+
+static const struct shwr_trig_reg shwr_trig_reg[FE_SHWR_TRIG_NTRIG]={
+  {COMPATIBILITY_SHWR_BUF_TRIG_SB,
+   COMPATIBILITY_SB_TRIG_THR0_ADDR,COMPATIBILITY_SB_TRIG_ENAB_ADDR,
+   COMPATIBILITY_SB_TRIG_ENAB_SHIFT,
+   COMPATIBILITY_SB_TRIG_COINC_LVL_SHIFT,COMPATIBILITY_SB_TRIG_COINC_LVL_MASK},
+  {COMPATIBILITY_SHWR_BUF_TRIG_TOT,COMPATIBILITY_TOT_TRIG_THR0_ADDR,-1,0,0,0},
+  {COMPATIBILITY_SHWR_BUF_TRIG_TOTD,COMPATIBILITY_TOTD_TRIG_THR0_ADDR,-1,0,0,0},
+  {COMPATIBILITY_SHWR_BUF_TRIG_MOPS,-1,-1,0,0,0},
+  {COMPATIBILITY_SHWR_BUF_TRIG_EXT,-1,-1,0,0,0},
+  {COMPATIBILITY_SHWR_BUF_TRIG_RNDM,-1,-1,0,0,0},
+  {SHWR_BUF_TRIG_LED,-1,-1,0,0,0}
+};
+/*  ID: shower_trigger_reg     end*/
+
+/* registers kept in the shadow: the ones only written by the software.
+   The global control (reset) and LED control (LED_NOW) are pulses and
+   the counters change by themselves, so they are left out. */
+static const int config_range[][2]={
+  {COMPATIBILITY_AMIGA_TRIG_ADDR,COMPATIBILITY_MOPS_TRIG_OFS_ADDR},
+  {COMPATIBILITY_SB_TRIG_THR0_ADDR,COMPATIBILITY_TOTD_TRIG_FN_ADDR},
+  {COMPATIBILITY_SCALAR_A_THR0_ADDR,COMPATIBILITY_SCALAR_A_ENAB_ADDR},
+  {COMPATIBILITY_SCALAR_B_THR0_ADDR,COMPATIBILITY_SCALAR_B_ENAB_ADDR},
+  {COMPATIBILITY_SCALAR_C_THR0_ADDR,COMPATIBILITY_SCALAR_C_ENAB_ADDR},
+  {SHWR_BUF_TRIG_MASK_ADDR,SHWR_BUF_TRIG_MASK_ADDR},
+  {MUON_TRIG1_THR0_ADDR,MUON_TRIG4_ENAB_ADDR},
+  {SB_TRIG_THR0_ADDR,SB_TRIG_ENAB_ADDR}
+};
+
+#define BIT_GET(v,i) (((v)[(i)/32]>>((i)%32)) & 1)
+#define BIT_SET(v,i) ((v)[(i)/32]|=1U<<((i)%32))
+
+struct fe_lib_global
+{
+  uint32_t volatile *regs;
+  int size;
+  int own;  /* 1: regs is the stand-in file mapping, 2: dev is ours */
+  struct rd_dev dev;
+
+  uint32_t shadow[FE_NREGS];
+  uint32_t valid[FE_NREGS/32];  /* shadow read from the hardware */
+  uint32_t dirty[FE_NREGS/32];  /* written, waiting for FeCommit */
+  uint32_t config[FE_NREGS/32]; /* kept in the shadow */
+  int batch;
+};
+
+static struct fe_lib_global gl;
+
+static void fe_init_shadow()
+{
+  int i,r;
+
+  memset(&gl,0,sizeof(gl));
+  for(i=0;i<sizeof(config_range)/sizeof(config_range[0]);i++){
+    for(r=config_range[i][0];r<=config_range[i][1];r++)
+      BIT_SET(gl.config,r);
+  }
+}
+
+int FeInit(const char *path)
+{
+  struct stat st;
+  int fd;
+
+  if(gl.regs!=NULL)
+    FeEnd();
+  fe_init_shadow();
+
+  if(path==NULL)
+    path=getenv(FE_REGS_FILE_ENV);
+  if(path==NULL){
+    rd_dev_init(&gl.dev);
+    if(rd_dev_open(&gl.dev,NULL,RD_DEV_MASK(RD_DEV_REGS))!=0)
+      return(FE_ERROR);
+    gl.regs=gl.dev.ptr[RD_DEV_REGS];
+    gl.own=2;
+    return(FE_OK);
+  }
+
+  /* stand-in for the registers, to work out of the UUB */
+  gl.size=FE_NREGS*sizeof(uint32_t);
+  if(gl.size%sysconf(_SC_PAGE_SIZE)){
+    gl.size=(gl.size/sysconf(_SC_PAGE_SIZE)+1)*sysconf(_SC_PAGE_SIZE);
+  }
+  fd=open(path,O_RDWR|O_CREAT,0644);
+  if(fd<0){
+    printf("Error - it was not possible to open %s\n",path);
+    return(FE_ERROR);
+  }
+  if(fstat(fd,&st)!=0 || (st.st_size<gl.size && ftruncate(fd,gl.size)!=0)){
+    printf("Error - it was not possible to size %s\n",path);
+    close(fd);
+    return(FE_ERROR);
+  }
+  gl.regs=(uint32_t *)mmap(NULL,gl.size,PROT_READ | PROT_WRITE,
+			   MAP_SHARED,fd,0);
+  close(fd); /*it is not needed to keep opened */
+  if(gl.regs==MAP_FAILED){
+    printf("Error - while trying to map the Registers\n");
+    gl.regs=NULL;
+    return(FE_ERROR);
+  }
+  gl.own=1;
+  return(FE_OK);
+}
+
+int FeInitDev(const struct rd_dev *d)
+{
+  if(gl.regs!=NULL)
+    FeEnd();
+  if(d->ptr[RD_DEV_REGS]==NULL)
+    return(FE_PARAM_ERROR);
+  fe_init_shadow();
+  gl.regs=d->ptr[RD_DEV_REGS];
+  return(FE_OK);
+}
+
+void FeEnd()
+{
+  if(gl.regs!=NULL){
+    if(gl.batch)
+      FeCommit();
+    if(gl.own==1)
+      munmap((void *)gl.regs,gl.size);
+    else if(gl.own==2)
+      rd_dev_close(&gl.dev);
+  }
+  gl.regs=NULL;
+  gl.own=0;
+}
+
+void FeShadowInvalidate()
+{
+  memset(gl.valid,0,sizeof(gl.valid));
+}
+
+void FeBegin()
+{
+  gl.batch=1;
+}
+
+int FeCommit()
+{
+  int r,n=0;
+
+  if(gl.regs==NULL)
+    return(0);
+  for(r=0;r<FE_NREGS;r++){
+    if(r!=SHWR_BUF_TRIG_MASK_ADDR && BIT_GET(gl.dirty,r)){
+      gl.regs[r]=gl.shadow[r];
+      n++;
+    }
+  }
+  if(BIT_GET(gl.dirty,SHWR_BUF_TRIG_MASK_ADDR)){
+    gl.regs[SHWR_BUF_TRIG_MASK_ADDR]=gl.shadow[SHWR_BUF_TRIG_MASK_ADDR];
+    n++;
+  }
+  memset(gl.dirty,0,sizeof(gl.dirty));
+  gl.batch=0;
+  return(n);
+}
+
+unsigned int FeGetReg( unsigned int reg )
+{
+  if(gl.regs==NULL || reg>=FE_NREGS)
+    return(0);
+  if(!BIT_GET(gl.config,reg))
+    return(gl.regs[reg]);
+  if(!BIT_GET(gl.valid,reg)){
+    gl.shadow[reg]=gl.regs[reg];
+    BIT_SET(gl.valid,reg);
+  }
+  return(gl.shadow[reg]);
+}
+
+int FeRegShadowed( unsigned int reg )
+{
+  return(reg<FE_NREGS && BIT_GET(gl.config,reg));
+}
+
+/* read the hardware even for the shadowed registers, and refresh the
+   shadow unless there is a write pending on it */
+unsigned int FeReadReg( unsigned int reg )
+{
+  uint32_t v;
+
+  if(gl.regs==NULL || reg>=FE_NREGS)
+    return(0);
+  v=gl.regs[reg];
+  if(BIT_GET(gl.config,reg) && !BIT_GET(gl.dirty,reg)){
+    gl.shadow[reg]=v;
+    BIT_SET(gl.valid,reg);
+  }
+  return(v);
+}
+
+void FeSetReg(unsigned int reg, uint32_t value )
+{
+  if(gl.regs==NULL || reg>=FE_NREGS)
+    return;
+  if(!BIT_GET(gl.config,reg)){
+    gl.regs[reg]=value;
+    return;
+  }
+  gl.shadow[reg]=value;
+  BIT_SET(gl.valid,reg);
+  if(gl.batch)
+    BIT_SET(gl.dirty,reg);
+  else
+    gl.regs[reg]=value;
+}
+
+void FeAndReg(unsigned int reg, uint32_t value )
+{
+  FeSetReg(reg,FeGetReg(reg) & value);
+}
+
+void FeOrReg( unsigned int reg, uint32_t value)
+{
+  FeSetReg(reg,FeGetReg(reg) | value);
+}
+
+int FeShwrReset()
+{
+  if(gl.regs==NULL)
+    return(FE_ERROR);
+  gl.regs[COMPATIBILITY_GLOBAL_CONTROL_ADDR]=COMPATIBILITY_GLOBAL_CONTROL_RESET;
+  FeShadowInvalidate();
+  return(FE_OK);
+}
+
+int FeShwrEnableTrigger(int tr,int enable)
+{
+  if(tr<0 || tr>=FE_SHWR_TRIG_NTRIG)
+    return(FE_PARAM_ERROR);
+  return(FeShwrEnableTriggerMask(1<<tr,enable));
+}
+
+int FeShwrEnableTriggerMask(int mask,int enable)
+{
+  uint32_t bits=0;
+  int tr;
+
+  if(gl.regs==NULL)
+    return(FE_ERROR);
+  if(mask & ~((1<<FE_SHWR_TRIG_NTRIG)-1))
+    return(FE_PARAM_ERROR);
+  for(tr=0;tr<FE_SHWR_TRIG_NTRIG;tr++){
+    if(mask & (1<<tr))
+      bits|=shwr_trig_reg[tr].mask_bit;
+  }
+  if(enable)
+    FeOrReg(SHWR_BUF_TRIG_MASK_ADDR,bits);
+  else
+    FeAndReg(SHWR_BUF_TRIG_MASK_ADDR,~bits);
+  return(FE_OK);
+}
+
+int FeShwrSetThreshold(int tr,const uint32_t th[3])
+{
+  int i;
+
+  if(gl.regs==NULL)
+    return(FE_ERROR);
+  if(tr<0 || tr>=FE_SHWR_TRIG_NTRIG)
+    return(FE_PARAM_ERROR);
+  if(shwr_trig_reg[tr].th_addr<0)
+    return(FE_NOT_IMPLEMENTED);
+  for(i=0;i<3;i++)
+    FeSetReg(shwr_trig_reg[tr].th_addr+i,th[i]);
+  return(FE_OK);
+}
+
+int FeShwrEnablePMT(int tr,int pmt,int enable)
+{
+  if(tr<0 || tr>=FE_SHWR_TRIG_NTRIG || pmt<0 || pmt>=3)
+    return(FE_PARAM_ERROR);
+  return(FeShwrEnablePMT_trmask_pmtmask(1<<tr,1<<pmt,enable));
+}
+
+int FeShwrEnablePMT_trmask(int tr_mask,int pmt,int enable)
+{
+  if(pmt<0 || pmt>=3)
+    return(FE_PARAM_ERROR);
+  return(FeShwrEnablePMT_trmask_pmtmask(tr_mask,1<<pmt,enable));
+}
+
+int FeShwrEnablePMT_trmask_pmtmask(int tr_mask,int pmt_mask,int enable)
+{
+  const struct shwr_trig_reg *t;
+  int tr;
+
+  if(gl.regs==NULL)
+    return(FE_ERROR);
+  if((tr_mask & ~((1<<FE_SHWR_TRIG_NTRIG)-1)) || (pmt_mask & ~FE_PMT_MASK))
+    return(FE_PARAM_ERROR);
+  for(tr=0;tr<FE_SHWR_TRIG_NTRIG;tr++){
+    t=&shwr_trig_reg[tr];
+    if(!(tr_mask & (1<<tr)))
+      continue;
+    if(t->enab_addr<0)
+      return(FE_NOT_IMPLEMENTED);
+    if(enable)
+      FeOrReg(t->enab_addr,pmt_mask<<t->pmt_shift);
+    else
+      FeAndReg(t->enab_addr,~(pmt_mask<<t->pmt_shift));
+  }
+  return(FE_OK);
+}
+
+int FeShwrEnablePMT_tr_set(int tr,int pmt_mask,int n_coincidenc)
+{
+  const struct shwr_trig_reg *t;
+  uint32_t v;
+
+  if(gl.regs==NULL)
+    return(FE_ERROR);
+  if(tr<0 || tr>=FE_SHWR_TRIG_NTRIG || (pmt_mask & ~FE_PMT_MASK))
+    return(FE_PARAM_ERROR);
+  t=&shwr_trig_reg[tr];
+  if(t->enab_addr<0)
+    return(FE_NOT_IMPLEMENTED);
+  if(n_coincidenc<0 || n_coincidenc>t->coinc_mask)
+    return(FE_PARAM_ERROR);
+  v=FeGetReg(t->enab_addr);
+  v&=~((FE_PMT_MASK<<t->pmt_shift) | (t->coinc_mask<<t->coinc_shift));
+  v|=(pmt_mask<<t->pmt_shift) | (n_coincidenc<<t->coinc_shift);
+  FeSetReg(t->enab_addr,v);
+  return(FE_OK);
+}
+
+int FeShwrNCoincidence(int trigger,unsigned int n)
+{
+  const struct shwr_trig_reg *t;
+  uint32_t v;
+
+  if(gl.regs==NULL)
+    return(FE_ERROR);
+  if(trigger<0 || trigger>=FE_SHWR_TRIG_NTRIG)
+    return(FE_PARAM_ERROR);
+  t=&shwr_trig_reg[trigger];
+  if(t->enab_addr<0)
+    return(FE_NOT_IMPLEMENTED);
+  if(n>t->coinc_mask)
+    return(FE_PARAM_ERROR);
+  v=FeGetReg(t->enab_addr) & ~(t->coinc_mask<<t->coinc_shift);
+  FeSetReg(t->enab_addr,v | (n<<t->coinc_shift));
+  return(FE_OK);
+}
+
+int FeShwrConfigure(const struct fe_shwr_config *c)
+{
+  const struct fe_shwr_trig_config *tc;
+  int tr,ret=FE_OK,aux,own_batch;
+
+  if(gl.regs==NULL)
+    return(FE_ERROR);
+  /* inside a batch of the caller, the caller commits */
+  own_batch=!gl.batch;
+  if(own_batch)
+    FeBegin();
+  for(tr=0;tr<FE_SHWR_TRIG_NTRIG;tr++){
+    if(!c->set[tr])
+      continue;
+    tc=&c->trig[tr];
+    if(shwr_trig_reg[tr].th_addr>=0){
+      aux=FeShwrSetThreshold(tr,tc->th);
+      if(aux!=FE_OK){
+        if(ret==FE_OK)
+          ret=aux;
+        continue; /* not enabled with the old thresholds */
+      }
+      /* the PMT settings are not implemented for all of them: reported
+         (FE_NOT_IMPLEMENTED), the trigger is still enabled */
+      aux=FeShwrEnablePMT_tr_set(tr,tc->pmt_mask,tc->ncoinc);
+      if(aux!=FE_OK){
+        if(ret==FE_OK)
+          ret=aux;
+        if(aux!=FE_NOT_IMPLEMENTED)
+          continue;
+      }
+    }
+    aux=FeShwrEnableTrigger(tr,tc->enable);
+    if(aux!=FE_OK && ret==FE_OK)
+      ret=aux;
+  }
+  if(own_batch)
+    FeCommit();
+  return(ret);
+}
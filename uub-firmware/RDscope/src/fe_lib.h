@@ -1,3 +1,5 @@
+#ifndef _FE_LIB_H
+#define _FE_LIB_H
 
 #include <stdint.h>
 /* shower traces definition */
@@ -46,6 +48,8 @@ enum{
 };
 
 unsigned int FeGetReg( unsigned int reg );
+unsigned int FeReadReg( unsigned int reg ); /* from the hardware */
+int FeRegShadowed( unsigned int reg ); /* a configuration register */
 void FeSetReg(unsigned int reg, uint32_t value );
 void FeAndReg(unsigned int reg, uint32_t value );
 void FeOrReg( unsigned int reg, uint32_t value);
@@ -54,9 +58,58 @@ int FeShwrReset();
 
 int FeShwrEnableTrigger(int tr,int enable);
 int FeShwrEnableTriggerMask(int mask,int enable);
-int FeShwrSetThreshold(int tr,uint32_t th[3]);
+int FeShwrSetThreshold(int tr,const uint32_t th[3]);
 int FeShwrEnablePMT(int tr,int pmt,int enable);
 int FeShwrEnablePMT_trmask(int tr_mask,int pmt,int enable);
 int FeShwrEnablePMT_trmask_pmtmask(int tr_mask,int pmt_mask,int enable);
 int FeShwrEnablePMT_tr_set(int tr,int pmt_mask,int n_coincidenc);
 int FeShwrNCoincidence(int trigger,unsigned int n);
+
+/* Register access. The configuration registers (thresholds, enables,
+   trigger mask, ...) are kept in a shadow copy: FeGetReg, FeAndReg and
+   FeOrReg do not read the hardware again once the register is known.
+   The other registers (status, counters) are always read through.
+
+   Between FeBegin and FeCommit the writes only go to the shadow and
+   FeCommit writes the modified registers at once, the trigger mask
+   last, so a trigger is not enabled with half of its configuration.
+   Outside of FeBegin/FeCommit every write goes to the hardware.
+*/
+#define FE_NREGS 256
+#define FE_REGS_FILE_ENV "FE_REGS_FILE"
+
+/* path NULL: the SDE trigger registers through the device context
+   (rd_dev.h), unless the FE_REGS_FILE environment variable names a
+   file which stands in for them (created if needed, FE_NREGS words) */
+int FeInit(const char *path);
+/* use the registers of a device context opened by the caller, which
+   keeps it open until FeEnd */
+struct rd_dev;
+int FeInitDev(const struct rd_dev *d);
+void FeEnd();
+void FeBegin();
+int FeCommit(); /* return the number of registers written */
+void FeShadowInvalidate(); /* read the hardware again */
+
+/* full configuration of the shower triggers with thresholds, written
+   with a single FeCommit, or left to the caller's FeCommit when called
+   between FeBegin and FeCommit. A trigger whose thresholds or PMT
+   settings fail is not touched in the trigger mask; the first error is
+   returned */
+struct fe_shwr_trig_config
+{
+  int enable;           /* in the trigger mask */
+  uint32_t th[3];       /* SB, TOT, TOTD only */
+  int pmt_mask;         /* PMTs included (SB only for now) */
+  unsigned int ncoinc;  /* coincidence level (SB only for now) */
+};
+
+struct fe_shwr_config
+{
+  struct fe_shwr_trig_config trig[FE_SHWR_TRIG_NTRIG];
+  int set[FE_SHWR_TRIG_NTRIG]; /* only the triggers set are touched */
+};
+
+int FeShwrConfigure(const struct fe_shwr_config *c);
+
+#endif /*_FE_LIB_H*/
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xparameters.h"
+#include "sde_trigger_defs.h"
+#include "led_pulse.h"
+
+static uint32_t led_ctrl(const struct led_pulse *p)
+{
+  return((p->delay<<LED_DELAY_SHIFT) | (p->width<<LED_PULSWID_SHIFT) |
+	 (p->pps ? LED_ENAPPS : 0));
+}
+
+int led_pulse_init(struct led_pulse *p,const struct rd_dev *d)
+{
+  memset(p,0,sizeof(*p));
+  if(d->ptr[RD_DEV_REGS]==NULL){
+    printf("led_pulse: the trigger registers are not mapped\n");
+    return(1);
+  }
+  p->ctrl=d->ptr[RD_DEV_REGS]+LED_CONTROL_ADDR;
+  p->delay=LED_PULSE_DELAY;
+  p->width=LED_PULSE_WIDTH;
+  return(0);
+}
+
+int led_pulse_set(struct led_pulse *p,uint32_t delay,uint32_t width)
+{
+  if(delay>LED_DELAY_MASK || width>LED_PULSWID_MASK){
+    printf("led_pulse: delay up to %u, width up to %u\n",LED_DELAY_MASK,
+	   LED_PULSWID_MASK);
+    return(1);
+  }
+  p->delay=delay;
+  p->width=width;
+  return(0);
+}
+
+void led_pulse_pps(struct led_pulse *p,int on)
+{
+  p->pps=on;
+  *p->ctrl=led_ctrl(p);
+}
+
+void led_pulse_fire(struct led_pulse *p)
+{
+  uint32_t v=led_ctrl(p);
+
+  *p->ctrl=v;
+  usleep(LED_PULSE_EDGE_US);
+  *p->ctrl=v | LED_NOW;
+  p->npulses++;
+}
+
+static void *led_thread(void *arg)
+{
+  struct led_pulse *p=(struct led_pulse *)arg;
+  struct timespec next,now;
+  uint32_t n;
+
+  clock_gettime(CLOCK_MONOTONIC,&next);
+  for(n=0;!p->stop && (p->count==0 || n<p->count);n++){
+    led_pulse_fire(p);
+    next.tv_nsec+=(p->period_us%1000000)*1000L;
+    next.tv_sec+=p->period_us/1000000+next.tv_nsec/1000000000L;
+    next.tv_nsec%=1000000000L;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    if(now.tv_sec>next.tv_sec ||
+       (now.tv_sec==next.tv_sec && now.tv_nsec>=next.tv_nsec)){
+      /* behind: start again from now rather than fire a burst */
+      p->nlate++;
+      next=now;
+      continue;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&next,NULL);
+  }
+  return(NULL);
+}
+
+int led_pulse_start(struct led_pulse *p,uint32_t period_us,uint32_t count)
+{
+  if(period_us<=LED_PULSE_EDGE_US){
+    printf("led_pulse: the period must be over %d us\n",LED_PULSE_EDGE_US);
+    return(1);
+  }
+  p->period_us=period_us;
+  p->count=count;
+  p->stop=0;
+  if(pthread_create(&p->thread,NULL,led_thread,p)!=0){
+    printf("led_pulse: not possible to start the thread\n");
+    return(1);
+  }
+  p->running=1;
+  return(0);
+}
+
+void led_pulse_stop(struct led_pulse *p)
+{
+  if(!p->running)
+    return;
+  p->stop=1;
+  pthread_join(p->thread,NULL);
+  p->running=0;
+}
+
+void led_pulse_print(FILE *fp,const struct led_pulse *p)
+{
+  fprintf(fp,"LED: %u pulses (delay %u, width %u), %u late",p->npulses,
+	  p->delay,p->width,p->nlate);
+  if(p->period_us>0)
+    fprintf(fp,", train period %u us",p->period_us);
+  fprintf(fp,"\n");
+}
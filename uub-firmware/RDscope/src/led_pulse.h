@@ -0,0 +1,52 @@
+/* LED / external pulse generator of the SDE trigger (LED_CONTROL).
+
+   The control register, mapped once with the device context (rd_dev.h),
+   holds the delay and the width of the pulse (LED_DELAY, LED_PULSWID
+   fields); a rising edge of LED_NOW fires a pulse and LED_ENAPPS fires
+   one at each PPS. A pulse train at a fixed period runs on a thread of
+   its own with absolute wakeups, so the readout does not pay for it.
+*/
+
+#ifndef _LED_PULSE_H
+#define _LED_PULSE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "rd_dev.h"
+
+#define LED_PULSE_DELAY 33504 /* the values the scope always used */
+#define LED_PULSE_WIDTH 118
+#define LED_PULSE_EDGE_US 100 /* LED_NOW low before the edge */
+
+struct led_pulse
+{
+  uint32_t volatile *ctrl;
+  uint32_t delay;
+  uint32_t width;
+  int pps;              /* LED_ENAPPS */
+
+  uint32_t period_us;   /* pulse train */
+  uint32_t count;       /* ... pulses, 0: until led_pulse_stop */
+  pthread_t thread;
+  volatile int stop;
+  int running;
+
+  volatile uint32_t npulses;
+  uint32_t nlate;       /* train pulses fired a period or more late */
+};
+
+/* the context must map RD_DEV_REGS */
+int led_pulse_init(struct led_pulse *p,const struct rd_dev *d);
+/* 1 if a value does not fit in its field */
+int led_pulse_set(struct led_pulse *p,uint32_t delay,uint32_t width);
+void led_pulse_pps(struct led_pulse *p,int on);
+void led_pulse_fire(struct led_pulse *p);
+
+int led_pulse_start(struct led_pulse *p,uint32_t period_us,uint32_t count);
+void led_pulse_stop(struct led_pulse *p);
+
+void led_pulse_print(FILE *fp,const struct led_pulse *p);
+
+#endif /*_LED_PULSE_H*/
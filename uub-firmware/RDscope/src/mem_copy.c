@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MEM_COPY_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MEM_COPY_SSE2
+#endif
+
+#include "mem_copy.h"
+
+static const char *copy_name[MEM_COPY_NTYPES]={
+  "word","memcpy","wide","simd","dma"
+};
+
+int mem_copy_type(const char *name)
+{
+  int i;
+
+  for(i=0;i<MEM_COPY_NTYPES;i++){
+    if(strcmp(name,copy_name[i])==0)
+      return(i);
+  }
+  return(-1);
+}
+
+const char *mem_copy_name(int type)
+{
+  if(type<0 || type>=MEM_COPY_NTYPES)
+    return("?");
+  return(copy_name[type]);
+}
+
+int mem_copy_open(struct mem_copy *c,int type,const char *dev,
+		  off_t base,size_t size)
+{
+  memset(c,0,sizeof(*c));
+  c->fd=-1;
+  c->type=type;
+  c->base=base;
+  c->size=size;
+  if(type<0 || type>=MEM_COPY_NTYPES)
+    return(1);
+  if(type!=MEM_COPY_DMA)
+    return(0);
+
+  if(dev==NULL){
+    printf("mem_copy: the %s copy needs a device\n",copy_name[type]);
+    return(1);
+  }
+  c->fd=open(dev,O_RDONLY);
+  if(c->fd<0){
+    printf("mem_copy: not possible to open %s\n",dev);
+    return(1);
+  }
+  return(0);
+}
+
+void mem_copy_close(struct mem_copy *c)
+{
+  if(c->fd>=0)
+    close(c->fd);
+  c->fd=-1;
+}
+
+static void copy_word(uint32_t *dst,const uint32_t volatile *src,size_t n)
+{
+  size_t i;
+
+  for(i=0;i<n/4;i++)
+    dst[i]=src[i];
+}
+
+static void copy_wide(uint32_t *dst,const uint32_t volatile *src,size_t n)
+{
+  const uint64_t volatile *s=(const uint64_t volatile *)src;
+  uint64_t *d=(uint64_t *)dst;
+  size_t i;
+
+  for(i=0;i<n/8;i+=2){
+    d[i]=s[i];
+    d[i+1]=s[i+1];
+  }
+}
+
+static void copy_simd(uint32_t *dst,const uint32_t volatile *src,size_t n)
+{
+#if defined(MEM_COPY_NEON)
+  const uint32_t *s=(const uint32_t *)src;
+  size_t i;
+
+  for(i=0;i<n/4;i+=4)
+    vst1q_u32(dst+i,vld1q_u32(s+i));
+#elif defined(MEM_COPY_SSE2)
+  const __m128i *s=(const __m128i *)src;
+  __m128i *d=(__m128i *)dst;
+  size_t i;
+
+  for(i=0;i<n/16;i++)
+    _mm_storeu_si128(d+i,_mm_load_si128(s+i));
+#else
+  copy_wide(dst,src,n);
+#endif
+}
+
+int mem_copy(struct mem_copy *c,void *dst,const uint32_t volatile *map,
+	     size_t off,size_t n)
+{
+  const uint32_t volatile *src=map+off/4;
+
+  switch(c->type){
+  case MEM_COPY_WORD:
+    copy_word(dst,src,n);
+    break;
+  case MEM_COPY_MEMCPY:
+    memcpy(dst,(const void *)src,n);
+    break;
+  case MEM_COPY_WIDE:
+    copy_wide(dst,src,n);
+    break;
+  case MEM_COPY_SIMD:
+    copy_simd(dst,src,n);
+    break;
+  case MEM_COPY_DMA:
+    if(pread(c->fd,dst,n,c->base+off)!=(ssize_t)n)
+      return(1);
+    break;
+  default:
+    return(1);
+  }
+  return(0);
+}
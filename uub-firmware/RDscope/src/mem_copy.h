@@ -0,0 +1,53 @@
+/* Copy strategies for the FPGA memories (RD memory, shower memories),
+   which are mapped non cached through /dev/mem: every load is a bus
+   transaction, so the width of the loads makes the copy speed.
+
+   MEM_COPY_WORD   - one 32 bits load per word (volatile loop)
+   MEM_COPY_MEMCPY - libc memcpy
+   MEM_COPY_WIDE   - 64 bits loads
+   MEM_COPY_SIMD   - 128 bits loads (NEON on the UUB, SSE2 on x86;
+                     falls back to 64 bits without them)
+   MEM_COPY_DMA    - pread from a device which moves the region with
+                     DMA (dev, at the region physical address).
+
+   The sizes and offsets must be multiple of 16 bytes.
+*/
+
+#ifndef _MEM_COPY_H
+#define _MEM_COPY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+enum{
+  MEM_COPY_WORD=0,
+  MEM_COPY_MEMCPY,
+  MEM_COPY_WIDE,
+  MEM_COPY_SIMD,
+  MEM_COPY_DMA,
+  MEM_COPY_NTYPES
+};
+
+struct mem_copy
+{
+  int type;
+  off_t base;   /* physical address of the region */
+  size_t size;
+  int fd;       /* MEM_COPY_DMA device */
+};
+
+int mem_copy_type(const char *name);
+const char *mem_copy_name(int type);
+
+/* dev: the device for MEM_COPY_DMA */
+int mem_copy_open(struct mem_copy *c,int type,const char *dev,
+		  off_t base,size_t size);
+void mem_copy_close(struct mem_copy *c);
+
+/* copy n bytes at offset off of the region; map is the region mapped
+   through /dev/mem */
+int mem_copy(struct mem_copy *c,void *dst,const uint32_t volatile *map,
+	     size_t off,size_t n);
+
+#endif /*_MEM_COPY_H*/
@@ -0,0 +1,103 @@
+// Copy speed of the RD memory (or the shower memory) with each of the
+// mem_copy.h strategies, checked against the word by word copy.
+//
+//   mem_copy_bench [-s] [-n iterations] [-d DMA device] [-f path]
+//
+//   -s  the shower memory 0 instead of the RD memory
+//   -f  the device to map the memory from, or a directory of stand-in
+//       files (rd_dev.h), out of the UUB
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "read_evt.h"
+#include "mem_copy.h"
+
+static double now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return(ts.tv_sec+ts.tv_nsec*1e-9);
+}
+
+int main(int argc,char *argv[])
+{
+  struct rd_dev d;
+  struct mem_copy mc;
+  const char *dev=NULL,*path=NULL;
+  const uint32_t volatile *map;
+  uint32_t *ref,*buf;
+  int region=RD_DEV_RD_MEM;
+  size_t size,chunk=RD_MEM_DEPTH;
+  double t0,t;
+  int i,c,type,niter=1000;
+
+  while((c=getopt(argc,argv,"sn:d:f:"))!=-1){
+    switch(c){
+    case 's':
+      region=RD_DEV_SHWR0;
+      chunk=SHWR_NSAMPLES*sizeof(uint32_t);
+      break;
+    case 'n':
+      niter=atoi(optarg);
+      break;
+    case 'd':
+      dev=optarg;
+      break;
+    case 'f':
+      path=optarg;
+      break;
+    default:
+      printf("usage: %s [-s] [-n iterations] [-d device] [-f file]\n",
+	     argv[0]);
+      return(1);
+    }
+  }
+  if(niter<1)
+    niter=1;
+
+  rd_dev_init(&d);
+  if(rd_dev_open(&d,path,RD_DEV_MASK(region))!=0)
+    return(1);
+  map=d.ptr[region];
+  size=d.size[region];
+  ref=malloc(size);
+  buf=malloc(size);
+  if(ref==NULL || buf==NULL)
+    return(1);
+  for(i=0;i<(int)(size/sizeof(uint32_t));i++)
+    ref[i]=map[i];
+
+  printf("%zu bytes per copy, %d copies\n",chunk,niter);
+  for(type=0;type<MEM_COPY_NTYPES;type++){
+    if(type==MEM_COPY_DMA && dev==NULL)
+      continue;
+    if(mem_copy_open(&mc,type,dev,d.addr[region],size)!=0)
+      continue;
+    memset(buf,0,size);
+    t0=now();
+    for(i=0;i<niter;i++){
+      if(mem_copy(&mc,buf,map,(i*chunk)%size,chunk)!=0)
+	break;
+    }
+    t=now()-t0;
+    if(i<niter){
+      printf("%-7s: copy error\n",mem_copy_name(type));
+    } else {
+      /* whole region once more to check it */
+      mem_copy(&mc,buf,map,0,size);
+      printf("%-7s: %8.2f us/copy %8.1f MB/s%s\n",mem_copy_name(type),
+	     t*1e6/niter,chunk*(double)niter/t*1e-6,
+	     memcmp(buf,ref,size)!=0 ? "  MISMATCH" : "");
+    }
+    mem_copy_close(&mc);
+  }
+  rd_dev_close(&d);
+  free(ref);
+  free(buf);
+  return(0);
+}
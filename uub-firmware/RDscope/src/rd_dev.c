@@ -0,0 +1,176 @@
+// Device context (rd_dev.h): one mapping for each of the UUB regions
+// used by the readout.
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+
+#include "xparameters.h"
+#include "sde_trigger_defs.h"
+#include "time_tagging.h"
+#include "rd_dev.h"
+
+#define RD_DEV_DEFAULT_PATH "/dev/mem"
+#define RD_DEV_NREGS 256 /* registers mapped for each register block */
+
+static const char *region_name[RD_DEV_NREGIONS]={
+  "regs","ttag","rd_regs","shwr0","shwr1","shwr2","shwr3","shwr4","rd_mem"
+};
+
+static size_t page_round(size_t size)
+{
+  size_t page=sysconf(_SC_PAGE_SIZE);
+
+  return((size+page-1)/page*page);
+}
+
+void rd_dev_init(struct rd_dev *d)
+{
+  static const off_t shwr_addr[5]={
+    TRIGGER_MEMORY_SHWR0_BASE,
+    TRIGGER_MEMORY_SHWR1_BASE,
+    TRIGGER_MEMORY_SHWR2_BASE,
+    TRIGGER_MEMORY_SHWR3_BASE,
+    TRIGGER_MEMORY_SHWR4_BASE
+  };
+  int i;
+
+  memset(d,0,sizeof(*d));
+  d->addr[RD_DEV_REGS]=SDE_TRIGGER_BASE;
+  d->addr[RD_DEV_TTAG]=TIME_TAGGING_BASE;
+  d->addr[RD_DEV_RD_REGS]=RD_BASE;
+  d->addr[RD_DEV_RD_MEM]=RD_EVENT_BASE;
+  d->size[RD_DEV_REGS]=page_round(RD_DEV_NREGS*sizeof(uint32_t));
+  d->size[RD_DEV_TTAG]=d->size[RD_DEV_REGS];
+  d->size[RD_DEV_RD_REGS]=d->size[RD_DEV_REGS];
+  d->size[RD_DEV_RD_MEM]=page_round(RD_MEM_DEPTH*RD_MEM_NBUF);
+  for(i=0;i<5;i++){
+    d->addr[RD_DEV_SHWR0+i]=shwr_addr[i];
+    d->size[RD_DEV_SHWR0+i]=page_round(SHWR_MEM_DEPTH*SHWR_MEM_NBUF);
+  }
+}
+
+int rd_dev_region(const char *name)
+{
+  int i;
+
+  for(i=0;i<RD_DEV_NREGIONS;i++){
+    if(strcasecmp(name,region_name[i])==0)
+      return(i);
+  }
+  return(-1);
+}
+
+const char *rd_dev_region_name(int r)
+{
+  if(r<0 || r>=RD_DEV_NREGIONS)
+    return("?");
+  return(region_name[r]);
+}
+
+int rd_dev_set_addr(struct rd_dev *d,const char *spec)
+{
+  char name[32];
+  const char *p;
+  char *end;
+  int r;
+
+  p=strchr(spec,'=');
+  if(p==NULL || p-spec>=(int)sizeof(name))
+    return(1);
+  memcpy(name,spec,p-spec);
+  name[p-spec]='\0';
+  r=rd_dev_region(name);
+  if(r<0)
+    return(1);
+  d->addr[r]=strtoul(p+1,&end,16);
+  if(*end!='\0' || d->addr[r]%sysconf(_SC_PAGE_SIZE)!=0)
+    return(1);
+  return(0);
+}
+
+/* a stand-in file for region r, sized as the region */
+static int stand_in_open(const struct rd_dev *d,int r)
+{
+  char file[320];
+  struct stat st;
+  int fd;
+
+  snprintf(file,sizeof(file),"%s/%s",d->path,region_name[r]);
+  fd=open(file,O_RDWR|O_CREAT,0644);
+  if(fd<0){
+    printf("Error - it was not possible to open %s\n",file);
+    return(-1);
+  }
+  if(fstat(fd,&st)!=0 || (st.st_size<(off_t)d->size[r] &&
+			  ftruncate(fd,d->size[r])!=0)){
+    printf("Error - it was not possible to size %s\n",file);
+    close(fd);
+    return(-1);
+  }
+  return(fd);
+}
+
+int rd_dev_open(struct rd_dev *d,const char *path,uint32_t mask)
+{
+  struct stat st;
+  void *p;
+  int fd=-1,r,rfd;
+
+  if(path==NULL)
+    path=getenv(RD_DEV_PATH_ENV);
+  if(path==NULL)
+    path=RD_DEV_DEFAULT_PATH;
+  strncpy(d->path,path,sizeof(d->path)-1);
+  d->path[sizeof(d->path)-1]='\0';
+  d->stand_in=(stat(path,&st)==0 && S_ISDIR(st.st_mode));
+  if(!d->stand_in){
+    fd=open(path,O_RDWR);
+    if(fd<0){
+      printf("Error - it was not possible to open %s\n",path);
+      return(1);
+    }
+  }
+
+  for(r=0;r<RD_DEV_NREGIONS;r++){
+    d->ptr[r]=NULL;
+    if(!(mask & RD_DEV_MASK(r)))
+      continue;
+    rfd=d->stand_in ? stand_in_open(d,r) : fd;
+    if(rfd<0)
+      break;
+    p=mmap(NULL,d->size[r],PROT_READ | PROT_WRITE,MAP_SHARED,rfd,
+	   d->stand_in ? 0 : d->addr[r]);
+    if(d->stand_in)
+      close(rfd);
+    if(p==MAP_FAILED){
+      printf("Error - while trying to map %s (%08lx)\n",region_name[r],
+	     (unsigned long)d->addr[r]);
+      break;
+    }
+    d->ptr[r]=(uint32_t volatile *)p;
+  }
+  if(fd>=0)
+    close(fd); /* the mappings stay */
+  if(r<RD_DEV_NREGIONS){
+    rd_dev_close(d);
+    return(1);
+  }
+  return(0);
+}
+
+void rd_dev_close(struct rd_dev *d)
+{
+  int r;
+
+  for(r=0;r<RD_DEV_NREGIONS;r++){
+    if(d->ptr[r]!=NULL)
+      munmap((void *)d->ptr[r],d->size[r]);
+    d->ptr[r]=NULL;
+  }
+}
@@ -0,0 +1,79 @@
+/* Device context: the UUB registers and memories used by the readout
+   (SDE trigger and time tagging registers, RD interface registers,
+   shower and RD memories), mapped once and shared by the tools.
+
+   The addresses come from xparameters.h and can be overridden before
+   rd_dev_open. The path is the device to map them from (/dev/mem by
+   default, or the RD_DEV_PATH environment variable), or a directory of
+   files which stand in for them out of the UUB: one file for each
+   region, named as the region and created if needed.
+*/
+
+#ifndef _RD_DEV_H
+#define _RD_DEV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define RD_BASE 0x43c60000
+#define RD_EVENT_BASE 0x52000000
+#define RD_MEM_DEPTH 8192
+#define RD_MEM_WORDS 2048
+#define RD_MEM_NBUF 4
+
+#define RD_DEV_PATH_ENV "RD_DEV_PATH"
+
+enum{
+  RD_DEV_REGS=0,  /* SDE trigger registers */
+  RD_DEV_TTAG,    /* time tagging registers */
+  RD_DEV_RD_REGS, /* RD interface registers */
+  RD_DEV_SHWR0,   /* shower memories, one for each raw channel */
+  RD_DEV_SHWR1,
+  RD_DEV_SHWR2,
+  RD_DEV_SHWR3,
+  RD_DEV_SHWR4,
+  RD_DEV_RD_MEM,  /* RD memory */
+  RD_DEV_NREGIONS
+};
+
+#define RD_DEV_ALL ((1U<<RD_DEV_NREGIONS)-1)
+#define RD_DEV_MASK(r) (1U<<(r))
+
+struct rd_dev
+{
+  char path[256];
+  int stand_in;  /* path is a directory of files */
+  off_t addr[RD_DEV_NREGIONS];
+  size_t size[RD_DEV_NREGIONS];
+  uint32_t volatile *ptr[RD_DEV_NREGIONS]; /* NULL if not mapped */
+
+  /* called after a write with rd_dev_write; set by the software model
+     (uub_emu.h) to apply it at once, as the FPGA does. NULL on the UUB */
+  void (*write_hook)(void *arg,int r,int addr);
+  void *hook_arg;
+};
+
+/* write a register which acts on the write (buffer release) */
+static inline void rd_dev_write(struct rd_dev *d,int r,int addr,uint32_t v)
+{
+  d->ptr[r][addr]=v;
+  if(d->write_hook!=NULL)
+    d->write_hook(d->hook_arg,r,addr);
+}
+
+/* default addresses and sizes, nothing mapped */
+void rd_dev_init(struct rd_dev *d);
+
+int rd_dev_region(const char *name); /* -1 if unknown */
+const char *rd_dev_region_name(int r);
+
+/* override an address, "name=hex address" */
+int rd_dev_set_addr(struct rd_dev *d,const char *spec);
+
+/* map the regions in mask (RD_DEV_MASK(r) bits). Return 0, or 1 with
+   nothing mapped. */
+int rd_dev_open(struct rd_dev *d,const char *path,uint32_t mask);
+void rd_dev_close(struct rd_dev *d);
+
+#endif /*_RD_DEV_H*/
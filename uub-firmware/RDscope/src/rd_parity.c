@@ -0,0 +1,77 @@
+#include <string.h>
+
+#include "rd_parity.h"
+#include "rd_interface_defs.h"
+
+uint32_t rd_parity_check(const uint32_t *rd,int n,struct rd_parity_result *r)
+{
+  uint32_t bad,acc0=0,acc1=0;
+  int i;
+
+  r->first[0]=r->first[1]=-1;
+  for(i=0;i<n;i++){
+    bad=rd_parity_bad(rd[i]);
+    acc0+=bad & 1;
+    acc1+=bad>>16;
+  }
+  r->nerr[0]=acc0;
+  r->nerr[1]=acc1;
+  if(acc0==0 && acc1==0)
+    return(0);
+
+  /* only for the buffers with errors */
+  for(i=0;i<n && (r->first[0]<0 || r->first[1]<0);i++){
+    bad=rd_parity_bad(rd[i]);
+    if((bad & 1) && r->first[0]<0)
+      r->first[0]=i;
+    if((bad>>16) && r->first[1]<0)
+      r->first[1]=i;
+  }
+  return(acc0+acc1);
+}
+
+void rd_parity_stats_reset(struct rd_parity_stats *s,uint32_t budget)
+{
+  memset(s,0,sizeof(*s));
+  s->budget=budget;
+}
+
+int rd_parity_add(struct rd_parity_stats *s,int buf,uint32_t rd_status,
+		  const struct rd_parity_result *r)
+{
+  uint32_t hw[2];
+  int ch;
+
+  if(buf<0 || buf>=RD_PARITY_NBUF)
+    return(0); /* not an RD buffer: nothing to count */
+  hw[0]=(rd_status>>(RD_PARITY0_SHIFT+buf)) & 1;
+  hw[1]=(rd_status>>(RD_PARITY1_SHIFT+buf)) & 1;
+  s->nevts++;
+  for(ch=0;ch<2;ch++){
+    s->nerr[buf][ch]+=r->nerr[ch];
+    if(r->nerr[ch]>0)
+      s->nevt_err[buf][ch]++;
+    if((r->nerr[ch]>0)!=hw[ch])
+      s->nhw_mismatch[ch]++;
+  }
+  if(r->nerr[0]+r->nerr[1]>s->budget){
+    s->nflagged++;
+    return(1);
+  }
+  return(0);
+}
+
+void rd_parity_print(FILE *fp,const struct rd_parity_stats *s)
+{
+  int b;
+
+  fprintf(fp,"RD parity: %u events, %u over the budget of %u errors,"
+	  " hardware mismatch ch0 %u ch1 %u\n",s->nevts,s->nflagged,
+	  s->budget,s->nhw_mismatch[0],s->nhw_mismatch[1]);
+  for(b=0;b<RD_PARITY_NBUF;b++){
+    fprintf(fp,"  buffer %d: ch0 %llu errors in %u events,"
+	    " ch1 %llu errors in %u events\n",b,
+	    (unsigned long long)s->nerr[b][0],s->nevt_err[b][0],
+	    (unsigned long long)s->nerr[b][1],s->nevt_err[b][1]);
+  }
+}
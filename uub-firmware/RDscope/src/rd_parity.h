@@ -0,0 +1,59 @@
+/* Parity check of the RD buffers. Each RD word holds two samples:
+   bit 0 is the parity of channel 0 and bits 1..12 its data, bit 16 the
+   parity of channel 1 and bits 17..28 its data. The parity is odd: the
+   13 bits of a channel have an odd number of bits set.
+
+   The check folds both channels of a word at once (no loop on the
+   bits), compares the result with the RD_PARITY0/1 status bits of the
+   buffer and keeps the error counts per buffer and channel.
+*/
+
+#ifndef _RD_PARITY_H
+#define _RD_PARITY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define RD_PARITY_NBUF 4     /* RD_MEM_NBUF */
+#define RD_PARITY_BITS 0x1fff1fff
+#define RD_PARITY_BUDGET 0   /* errors allowed in a event */
+
+/* bit 0: channel 0 parity error, bit 16: channel 1 parity error */
+static inline uint32_t rd_parity_bad(uint32_t w)
+{
+  w&=RD_PARITY_BITS;
+  w^=(w>>8) & 0x00ff00ff; /* fold each 16 bits half on its own */
+  w^=(w>>4) & 0x000f000f;
+  w^=(w>>2) & 0x00030003;
+  w^=(w>>1) & 0x00010001;
+  return(~w & 0x00010001);
+}
+
+struct rd_parity_result
+{
+  uint32_t nerr[2];
+  int first[2]; /* first sample with error, -1: none */
+};
+
+struct rd_parity_stats
+{
+  uint32_t budget;  /* events with more errors are flagged */
+  uint32_t nevts;
+  uint32_t nflagged;
+  uint64_t nerr[RD_PARITY_NBUF][2];      /* samples with error */
+  uint32_t nevt_err[RD_PARITY_NBUF][2];  /* events with errors */
+  uint32_t nhw_mismatch[2]; /* the check and RD_PARITYn do not agree */
+};
+
+/* return the number of errors in the n words */
+uint32_t rd_parity_check(const uint32_t *rd,int n,struct rd_parity_result *r);
+
+void rd_parity_stats_reset(struct rd_parity_stats *s,uint32_t budget);
+/* count the result r of rd_parity_check for the event in the RD buffer
+   buf, read with the RD_IFC_STATUS rd_status. return 1 if over the
+   budget, 0 (not counted) for a buf out of 0..RD_PARITY_NBUF-1. */
+int rd_parity_add(struct rd_parity_stats *s,int buf,uint32_t rd_status,
+		  const struct rd_parity_result *r);
+void rd_parity_print(FILE *fp,const struct rd_parity_stats *s);
+
+#endif /*_RD_PARITY_H*/
@@ -0,0 +1,566 @@
+// Shower and RD event readout from the UUB trigger and RD interface
+// memories, through /dev/mem.
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "read_evt.h"
+#include "rd_interface_defs.h"
+#include "evt_wait.h"
+#include "evt_stats.h"
+#include "evt_pair.h"
+#include "rd_parity.h"
+#include "mem_copy.h"
+#include "ttag_cal.h"
+
+u32 rd_mem[RD_MEM_WORDS] __attribute__((aligned(128)));
+
+struct read_evt_global
+{
+  uint32_t id_counter;
+  struct rd_dev *dev;     /* the mappings (rd_dev.h) */
+  struct rd_dev own_dev;  /* ... when not given by read_evt_set_dev */
+  uint32_t volatile *shwr_pt[5];
+  uint32_t volatile *regs;
+  uint32_t volatile *ttag_regs;
+  uint32_t volatile *rd_regs;
+  uint32_t volatile *rd_mem_ptr;
+
+  int wait_type;       /* EVT_WAIT_TIMER, EVT_WAIT_UIO, ... */
+  const char *wait_dev;
+  struct evt_wait wait; /*used to wake the process when there are events*/
+
+  /* outstanding leases, in the order they were given. The hardware
+     buffers are released in this same order. */
+  struct evt_lease lease[SHWR_MEM_NBUF];
+  int lease_head;
+  int lease_count;
+  int shwr_next; /* the buffer after the last one given back */
+
+  struct evt_stats stats;
+
+  struct read_evt_rd_wait rd_wait;
+  struct read_evt_rd_health rd_health;
+  struct evt_pair pair; /* shower/RD buffer pairing */
+  uint32_t parity_budget;
+  pthread_mutex_t parity_lock; /* read_evt_rd_check runs in the writers */
+  struct rd_parity_stats parity;
+  struct ttag_cal ttag_cal; /* calibrated time tags */
+
+  int shwr_copy_type;  /* MEM_COPY_MEMCPY, ... (mem_copy.h) */
+  int rd_copy_type;
+  const char *copy_dev;
+  struct mem_copy shwr_copy[5];
+  struct mem_copy rd_copy;
+};
+
+static struct read_evt_global gl={
+  .rd_wait={RD_WAIT_SPIN,RD_WAIT_YIELD,RD_WAIT_SLEEP_US,RD_WAIT_TIMEOUT_US},
+  .parity_budget=RD_PARITY_BUDGET,
+  .parity_lock=PTHREAD_MUTEX_INITIALIZER,
+  .shwr_copy_type=MEM_COPY_MEMCPY,
+  .rd_copy_type=MEM_COPY_WORD
+};
+
+void read_evt_set_wait(int wait_type,const char *dev)
+{
+  gl.wait_type=wait_type;
+  gl.wait_dev=dev;
+}
+
+void read_evt_set_dev(struct rd_dev *d)
+{
+  gl.dev=d;
+}
+
+void read_evt_set_copy(int shwr_type,int rd_type,const char *dev)
+{
+  gl.shwr_copy_type=shwr_type;
+  gl.rd_copy_type=rd_type;
+  gl.copy_dev=dev;
+}
+
+struct evt_wait *read_evt_wait()
+{
+  return(&gl.wait);
+}
+
+uint32_t volatile *read_evt_regs()
+{
+  return(gl.regs);
+}
+
+void read_evt_set_rd_wait(const struct read_evt_rd_wait *w)
+{
+  struct read_evt_rd_wait def={
+    RD_WAIT_SPIN,RD_WAIT_YIELD,RD_WAIT_SLEEP_US,RD_WAIT_TIMEOUT_US
+  };
+
+  gl.rd_wait=(w!=NULL) ? *w : def;
+}
+
+void read_evt_set_parity_budget(uint32_t budget)
+{
+  gl.parity_budget=budget;
+}
+
+const struct read_evt_rd_health *read_evt_rd_health()
+{
+  return(&gl.rd_health);
+}
+
+void read_evt_rd_health_print(FILE *fp)
+{
+  const struct read_evt_rd_health *h=&gl.rd_health;
+
+  fprintf(fp,"RD link: %u events, %u waited (spin %u, yield %u, sleep %u),"
+	  " %u timeouts, max wait %.1f us\n",h->nevts,h->nbusy,h->nspin,
+	  h->nyield,h->nsleep,h->ntimeout,h->max_wait_ns*1e-3);
+  fprintf(fp,"RD link: parity errors ch0 %u ch1 %u\n",
+	  h->nparity0,h->nparity1);
+  evt_pair_print(fp,&gl.pair);
+  pthread_mutex_lock(&gl.parity_lock);
+  rd_parity_print(fp,&gl.parity);
+  pthread_mutex_unlock(&gl.parity_lock);
+}
+
+const struct ttag_cal *read_evt_ttag_cal()
+{
+  return(&gl.ttag_cal);
+}
+
+struct evt_stats *read_evt_stats()
+{
+  return(&gl.stats);
+}
+
+void read_evt_stats_enable(int on)
+{
+  gl.stats.enabled=on;
+  evt_stats_reset(&gl.stats);
+}
+
+int read_evt_init()
+{
+  int i;
+
+  memset(&gl.rd_health,0,sizeof(gl.rd_health));
+  ttag_cal_init(&gl.ttag_cal);
+  rd_parity_stats_reset(&gl.parity,gl.parity_budget);
+
+  if(gl.dev==NULL){
+    rd_dev_init(&gl.own_dev);
+    if(rd_dev_open(&gl.own_dev,NULL,RD_DEV_ALL)!=0)
+      return(1);
+    gl.dev=&gl.own_dev;
+  }
+  for(i=0;i<RD_DEV_NREGIONS;i++){
+    if(gl.dev->ptr[i]==NULL){
+      printf("Error - %s is not mapped\n",rd_dev_region_name(i));
+      read_evt_end();
+      return(1);
+    }
+  }
+  gl.regs=gl.dev->ptr[RD_DEV_REGS];
+  gl.ttag_regs=gl.dev->ptr[RD_DEV_TTAG];
+  gl.rd_regs=gl.dev->ptr[RD_DEV_RD_REGS];
+  for(i=0;i<5;i++)
+    gl.shwr_pt[i]=gl.dev->ptr[RD_DEV_SHWR0+i];
+  gl.rd_mem_ptr=gl.dev->ptr[RD_DEV_RD_MEM];
+
+  for(i=0;i<5;i++){
+    if(mem_copy_open(&gl.shwr_copy[i],gl.shwr_copy_type,gl.copy_dev,
+		     gl.dev->addr[RD_DEV_SHWR0+i],
+		     gl.dev->size[RD_DEV_SHWR0+i])!=0){
+      printf("Error - while trying to set the shower %s copy\n",
+	     mem_copy_name(gl.shwr_copy_type));
+      read_evt_end();
+      return(1);
+    }
+  }
+  if(mem_copy_open(&gl.rd_copy,gl.rd_copy_type,gl.copy_dev,
+		   gl.dev->addr[RD_DEV_RD_MEM],gl.dev->size[RD_DEV_RD_MEM])!=0){
+    printf("Error - while trying to set the RD %s copy\n",
+	   mem_copy_name(gl.rd_copy_type));
+    read_evt_end();
+    return(1);
+  }
+
+  //the process sleep until there are events: either polling
+  //periodically (timer) or waiting for the shower trigger interrupt.
+  if(evt_wait_open(&gl.wait,gl.wait_type,gl.wait_dev)!=0){
+    printf("Error - while trying to set the event wait (%d)\n",
+	   gl.wait_type);
+    read_evt_end();
+    return(1);
+  }
+  gl.id_counter=0;
+  gl.lease_head=0;
+  gl.lease_count=0;
+  gl.shwr_next=(gl.regs[SHWR_BUF_STATUS_ADDR]>>SHWR_BUF_RNUM_SHIFT) &
+    SHWR_BUF_RNUM_MASK;
+  evt_pair_init(&gl.pair,(gl.rd_regs[RD_IFC_STATUS_ADDR]>>RD_BUF_RNUM_SHIFT) &
+		RD_BUF_RNUM_MASK);
+  return(0);
+}
+
+int read_evt_end()
+{
+  int i;
+
+  if(gl.dev==&gl.own_dev){
+    rd_dev_close(&gl.own_dev);
+    gl.dev=NULL;
+  }
+  gl.regs=gl.ttag_regs=gl.rd_regs=gl.rd_mem_ptr=NULL;
+  for(i=0;i<5;i++)
+    gl.shwr_pt[i]=NULL;
+  for(i=0;i<5;i++)
+    mem_copy_close(&gl.shwr_copy[i]);
+  mem_copy_close(&gl.rd_copy);
+  if(gl.wait.ops!=NULL)
+    evt_wait_close(&gl.wait);
+  return(0);
+}
+
+
+static uint32_t lease_rd_wait(struct evt_lease *l);
+
+/* pair the lease with its RD buffer (see evt_pair.h); the orphan RD
+   buffers are given back to the interface. */
+static void lease_pair_rd(struct evt_lease *l,uint32_t ctr)
+{
+  uint32_t rd_status;
+  int drop[EVT_PAIR_NBUF];
+  int i,ndrop,ret;
+  uint64_t t0=0;
+
+  if(gl.stats.enabled)
+    t0=evt_stats_now();
+  rd_status=lease_rd_wait(l);
+  l->rd_status=rd_status;
+  if(gl.stats.enabled)
+    evt_stats_add(&gl.stats,EVT_PH_RD_BUSY,evt_stats_now()-t0);
+
+  evt_pair_rd_update(&gl.pair,
+		     (rd_status>>RD_BUF_FULL_SHIFT) & RD_BUF_FULL_MASK,
+		     gl.ttag_regs[TTAG_PPS_SECONDS_ADDR] & TTAG_SECONDS_MASK);
+  ret=evt_pair_match(&gl.pair,ctr,l->ev_gps_info.second,
+		     &l->rd_buf,drop,&ndrop);
+  for(i=0;i<ndrop;i++)
+    rd_dev_write(gl.dev,RD_DEV_RD_REGS,RD_IFC_CONTROL_ADDR,drop[i]);
+
+  gl.rd_health.nevts++;
+  if(ret!=EVT_PAIR_OK){
+    l->flags|=EVT_LEASE_RD_MISSING;
+    l->rd_buf=-1;
+    l->rd_raw=NULL;
+    return;
+  }
+  l->flags&=~EVT_LEASE_RD_MISSING;
+  l->rd_raw=gl.rd_mem_ptr+l->rd_buf*RD_MEM_WORDS;
+  if((rd_status>>(RD_PARITY0_SHIFT+l->rd_buf)) & 1)
+    gl.rd_health.nparity0++;
+  if((rd_status>>(RD_PARITY1_SHIFT+l->rd_buf)) & 1)
+    gl.rd_health.nparity1++;
+}
+
+static int lease_rnum()
+{
+  return((gl.regs[SHWR_BUF_STATUS_ADDR]>>SHWR_BUF_RNUM_SHIFT) &
+	 SHWR_BUF_RNUM_MASK);
+}
+
+/* the trigger and time tag registers describe the oldest buffer which
+   was not released yet (SHWR_BUF_RNUM); read them into the lease which
+   is using that buffer and pair it with its RD buffer. */
+static void lease_read_meta(struct evt_lease *l)
+{
+  uint32_t sec;
+
+  l->trace_start=gl.regs[SHWR_BUF_START_ADDR];
+  l->Evt_type_1=gl.regs[SHWR_BUF_TRIG_ID_ADDR];
+  sec=ttag_cal_read(&gl.ttag_cal,gl.ttag_regs,&l->ev_gps_info);
+  l->flags|=EVT_LEASE_META;
+  lease_pair_rd(l,(sec>>TTAG_EVTCTR_SHIFT) & TTAG_EVTCTR_MASK);
+}
+
+/* wait the RD interface to finish the transfer of the last event,
+   return the last status read. */
+static uint32_t lease_rd_wait(struct evt_lease *l)
+{
+  struct read_evt_rd_health *h=&gl.rd_health;
+  struct timespec ts;
+  uint32_t rd_status,n;
+  uint64_t t0,dt;
+
+  rd_status=gl.rd_regs[RD_IFC_STATUS_ADDR];
+  if(((rd_status>>RD_BUF_BUSY_SHIFT) & RD_BUF_BUSY_MASK)==0)
+    return(rd_status);
+  h->nbusy++;
+  t0=evt_stats_now();
+
+  for(n=0;n<gl.rd_wait.spin;n++){
+    rd_status=gl.rd_regs[RD_IFC_STATUS_ADDR];
+    if(((rd_status>>RD_BUF_BUSY_SHIFT) & RD_BUF_BUSY_MASK)==0){
+      h->nspin++;
+      goto done;
+    }
+  }
+  for(n=0;n<gl.rd_wait.yield;n++){
+    sched_yield();
+    rd_status=gl.rd_regs[RD_IFC_STATUS_ADDR];
+    if(((rd_status>>RD_BUF_BUSY_SHIFT) & RD_BUF_BUSY_MASK)==0){
+      h->nyield++;
+      goto done;
+    }
+  }
+  ts.tv_sec=gl.rd_wait.sleep_us/1000000;
+  ts.tv_nsec=(gl.rd_wait.sleep_us%1000000)*1000;
+  while(evt_stats_now()-t0<(uint64_t)gl.rd_wait.timeout_us*1000){
+    nanosleep(&ts,NULL);
+    rd_status=gl.rd_regs[RD_IFC_STATUS_ADDR];
+    if(((rd_status>>RD_BUF_BUSY_SHIFT) & RD_BUF_BUSY_MASK)==0){
+      h->nsleep++;
+      goto done;
+    }
+  }
+  h->ntimeout++;
+  l->flags|=EVT_LEASE_RD_MISSING;
+
+ done:
+  dt=evt_stats_now()-t0;
+  if(dt>h->max_wait_ns)
+    h->max_wait_ns=dt;
+  return(rd_status);
+}
+
+static int lease_nfull()
+{
+  return((gl.regs[SHWR_BUF_STATUS_ADDR]>>SHWR_BUF_NFULL_SHIFT) &
+	 SHWR_BUF_NFULL_MASK);
+}
+
+/* is there a full buffer not leased yet? The FPGA read buffer
+   (SHWR_BUF_RNUM) is the reference: a shower buffer reset (FeShwrReset,
+   reg) or a release by another process moves it without us. */
+static int lease_ready()
+{
+  uint32_t st=gl.regs[SHWR_BUF_STATUS_ADDR];
+  int rnum=(st>>SHWR_BUF_RNUM_SHIFT) & SHWR_BUF_RNUM_MASK;
+
+  if(gl.lease_count==0 && rnum!=gl.shwr_next){
+    printf("read_evt: shower read buffer is %d, %d expected: re-sync\n",
+	   rnum,gl.shwr_next);
+    gl.shwr_next=rnum;
+  }
+  return(((st>>SHWR_BUF_NFULL_SHIFT) & SHWR_BUF_NFULL_MASK)>gl.lease_count);
+}
+
+struct evt_lease *read_evt_lease()
+{
+  struct evt_lease *l,*prev;
+  int sig,i,offset;
+  uint64_t t0=0,t1=0;
+
+  if(gl.lease_count>=SHWR_MEM_NBUF){
+    printf("read_evt_lease: all the %d buffers are leased\n",
+	   SHWR_MEM_NBUF);
+    return(NULL);
+  }
+
+  /*wait for a wakeup (periodical signal or trigger interrupt) and
+    check if there is a event trigger which is not leased yet. The
+    status is checked again after arming, so a trigger between the
+    check and the wait is not lost.
+  */
+  if(gl.stats.enabled)
+    t0=evt_stats_now();
+  sig=0;
+  while(!lease_ready() && sig==0){
+    sig=evt_wait_arm(&gl.wait);
+    if(sig==0 && !lease_ready())
+      sig=evt_wait_wait(&gl.wait);
+  }
+  if(sig!=0)
+    return(NULL);
+
+  l=&gl.lease[(gl.lease_head+gl.lease_count)%SHWR_MEM_NBUF];
+  memset(l,0,sizeof(*l));
+  if(gl.stats.enabled){
+    t1=evt_stats_now();
+    evt_stats_add(&gl.stats,EVT_PH_WAIT,t1-t0);
+    evt_stats_sample(&gl.stats,gl.ttag_regs[TTAG_DEAD_CTR_ADDR],
+		     lease_nfull());
+    l->t_ready=t1;
+  }
+  if(gl.lease_count==0){
+    l->shwr_buf=lease_rnum();
+  } else {
+    prev=&gl.lease[(gl.lease_head+gl.lease_count-1)%SHWR_MEM_NBUF];
+    l->shwr_buf=(prev->shwr_buf+1) & SHWR_BUF_RNUM_MASK;
+  }
+  offset=l->shwr_buf*SHWR_NSAMPLES;
+  for(i=0;i<SHWR_RAW_NCH_MAX;i++)
+    l->fadc_raw[i]=gl.shwr_pt[i]+offset;
+  l->id=gl.id_counter; /*just a internal counter */
+  l->rd_buf=-1;
+  if(gl.lease_count==0)
+    lease_read_meta(l);
+
+  gl.lease_count++;
+  gl.id_counter++;
+  return(l);
+}
+
+int read_evt_release(struct evt_lease *l)
+{
+  struct evt_lease *head;
+  int pos;
+  uint64_t t0=0,t1;
+
+  pos=(l-gl.lease-gl.lease_head+SHWR_MEM_NBUF)%SHWR_MEM_NBUF;
+  if(l<gl.lease || l>=gl.lease+SHWR_MEM_NBUF || pos>=gl.lease_count ||
+     (l->flags & EVT_LEASE_HELD)){
+    printf("read_evt_release: not a outstanding lease\n");
+    return(1);
+  }
+  l->flags|=EVT_LEASE_HELD; /* released by the caller */
+  if(gl.stats.enabled)
+    t0=evt_stats_now();
+
+  /* the FPGA expects the buffers back in the order it filled them;
+     a lease released out of order stays until the older ones go. */
+  while(gl.lease_count>0){
+    head=&gl.lease[gl.lease_head];
+    if(!(head->flags & EVT_LEASE_HELD))
+      break;
+    rd_dev_write(gl.dev,RD_DEV_REGS,SHWR_BUF_CONTROL_ADDR,head->shwr_buf);
+    gl.shwr_next=(head->shwr_buf+1) & SHWR_BUF_RNUM_MASK;
+    if(head->rd_buf>=0){
+      rd_dev_write(gl.dev,RD_DEV_RD_REGS,RD_IFC_CONTROL_ADDR,head->rd_buf);
+      evt_pair_rd_done(&gl.pair,head->rd_buf);
+    }
+    if(gl.stats.enabled){
+      t1=evt_stats_now();
+      evt_stats_add(&gl.stats,EVT_PH_RELEASE,t1-t0);
+      evt_stats_add(&gl.stats,EVT_PH_READOUT,t1-head->t_ready);
+      t0=t1;
+    }
+    head->flags=0;
+    gl.lease_head=(gl.lease_head+1)%SHWR_MEM_NBUF;
+    gl.lease_count--;
+    /* the next outstanding lease is now the hardware read buffer */
+    if(gl.lease_count>0)
+      lease_read_meta(&gl.lease[gl.lease_head]);
+  }
+  return(0);
+}
+
+int read_evt_lease_window(const struct evt_lease *l,int ch,
+			  int first,int n,uint32_t *dst)
+{
+  const uint32_t volatile *src;
+  int i,index;
+
+  if(ch<0 || ch>=SHWR_RAW_NCH_MAX || n<0 || n>SHWR_NSAMPLES)
+    return(1);
+  src=l->fadc_raw[ch];
+  index=(l->trace_start+first)%SHWR_NSAMPLES;
+  if(index<0)
+    index+=SHWR_NSAMPLES;
+  for(i=0;i<n;i++){
+    dst[i]=src[index];
+    index++;
+    if(index==SHWR_NSAMPLES)
+      index=0;
+  }
+  return(0);
+}
+
+int read_evt_lease_copy(struct evt_lease *l,struct shwr_evt_raw *shwr,
+			uint32_t *rd)
+{
+  int i;
+  uint64_t t0=0,t1;
+
+  /* the trigger registers were not read for it yet (not the oldest
+     lease): there is no event to give */
+  if(!(l->flags & EVT_LEASE_META))
+    return(1);
+  if(gl.stats.enabled)
+    t0=evt_stats_now();
+  for(i=0;i<SHWR_RAW_NCH_MAX;i++){
+    if(mem_copy(&gl.shwr_copy[i],shwr->fadc_raw[i],gl.shwr_pt[i],
+		(l->fadc_raw[i]-gl.shwr_pt[i])*sizeof(uint32_t),
+		sizeof(uint32_t)*SHWR_NSAMPLES)!=0)
+      return(1);
+  }
+  if(gl.stats.enabled){
+    t1=evt_stats_now();
+    evt_stats_add(&gl.stats,EVT_PH_SHWR_COPY,t1-t0);
+    t0=t1;
+  }
+  shwr->id=l->id;
+  shwr->trace_start=l->trace_start;
+  shwr->Evt_type_1=l->Evt_type_1;
+  shwr->Evt_type_2=0;
+  shwr->ev_gps_info=l->ev_gps_info;
+  shwr->nsamples=SHWR_NSAMPLES;
+  /* not paired yet (not the oldest lease): no RD data either */
+  if(l->rd_raw==NULL)
+    l->flags|=EVT_LEASE_RD_MISSING;
+  if(!(l->flags & EVT_LEASE_RD_MISSING) &&
+     mem_copy(&gl.rd_copy,rd,gl.rd_mem_ptr,l->rd_buf*RD_MEM_DEPTH,
+	      RD_MEM_DEPTH)!=0){
+    printf("Error - RD buffer %d copy failed\n",l->rd_buf);
+    l->flags|=EVT_LEASE_RD_MISSING;
+  }
+  /* the raw words only: the parity is checked by the consumer of the
+     copy (read_evt_rd_check), not while the buffers are held */
+  if(l->flags & EVT_LEASE_RD_MISSING)
+    memset(rd,0,sizeof(uint32_t)*RD_MEM_WORDS);
+  if(gl.stats.enabled)
+    evt_stats_add(&gl.stats,EVT_PH_RD_COPY,evt_stats_now()-t0);
+  return(0);
+}
+
+int read_evt_rd_check(const uint32_t *rd,int rd_buf,uint32_t rd_status)
+{
+  struct rd_parity_result pr;
+  int ret;
+
+  rd_parity_check(rd,RD_MEM_WORDS,&pr);
+  pthread_mutex_lock(&gl.parity_lock);
+  ret=rd_parity_add(&gl.parity,rd_buf,rd_status,&pr);
+  pthread_mutex_unlock(&gl.parity_lock);
+  return(ret);
+}
+
+int read_evt_read(struct shwr_evt_raw *shwr)
+{
+  struct evt_lease *l;
+  struct evt_lease done;
+  int ret;
+
+  l=read_evt_lease();
+  if(l==NULL)
+    return(1);
+  ret=read_evt_lease_copy(l,shwr,rd_mem);
+  done=*l;
+  read_evt_release(l);
+  if(ret!=0)
+    return(1);
+  if(!(done.flags & EVT_LEASE_RD_MISSING))
+    read_evt_rd_check(rd_mem,done.rd_buf,done.rd_status);
+  return(0);
+}
@@ -1,10 +1,126 @@
+#include <stdio.h>
 #include "shwr_evt_defs.h"
 #include "xparameters.h"
 #include "sde_trigger_defs.h"
+#include "time_tagging.h"
+#include "rd_dev.h"
 
+#ifndef _READ_EVT_H
+#define _READ_EVT_H
 
+extern u32 rd_mem[RD_MEM_WORDS];
 
-int read_evt_init();
+/* A lease is a read-only view straight into the mapped shower and RD
+   buffers of one event. The buffers belong to the lease until it is
+   given back with read_evt_release; the FPGA does not write on them
+   meanwhile. Up to SHWR_MEM_NBUF leases may be outstanding; they may
+   be released in any order, but the buffers go back to the FPGA in
+   the order they were leased.
+
+   The trigger registers (trace start, trigger id, time tag) only
+   describe the oldest buffer not released yet, so a lease taken while
+   others are outstanding gets them (EVT_LEASE_META) when the older
+   leases are released. The RD buffer is paired with the shower event
+   (evt_pair.h) at that same time: until then, or if there is no RD
+   for the event (EVT_LEASE_RD_MISSING), rd_buf is -1 and rd_raw NULL.
+*/
+#define EVT_LEASE_META 1 /* trace_start, Evt_type_1, gps info are valid */
+#define EVT_LEASE_HELD 2 /* internal: released, waiting for older ones */
+#define EVT_LEASE_RD_MISSING 4 /* RD transfer timed out, rd_raw not valid */
+#define EVT_LEASE_RD_PARITY 8  /* RD parity errors over the budget, set
+				  by the caller from read_evt_rd_check */
+
+struct evt_lease
+{
+  uint32_t id;
+  uint32_t flags;
+  int shwr_buf;  /* shower buffer number */
+  int rd_buf;    /* RD buffer number, -1: none */
+  uint32_t Evt_type_1;
+  int trace_start;
+  struct shwr_gps_info ev_gps_info;
+  uint32_t rd_status; /* RD_IFC_STATUS_ADDR when the lease was taken */
+  const uint32_t volatile *fadc_raw[SHWR_RAW_NCH_MAX]; /* SHWR_NSAMPLES */
+  const uint32_t volatile *rd_raw;                      /* RD_MEM_WORDS */
+  uint64_t t_ready; /* internal: monotonic ns when the event was seen */
+};
+
+/* Wait for the RD interface to finish the transfer of an event
+   (RD_BUF_BUSY): spin polls first, then yield polls giving the CPU
+   away, then polls every sleep_us until timeout_us from the start.
+   On timeout the lease is given with EVT_LEASE_RD_MISSING; the shower
+   data is still good.
+*/
+struct read_evt_rd_wait
+{
+  uint32_t spin;
+  uint32_t yield;
+  uint32_t sleep_us;
+  uint32_t timeout_us;
+};
+
+#define RD_WAIT_SPIN 1000
+#define RD_WAIT_YIELD 100
+#define RD_WAIT_SLEEP_US 50
+#define RD_WAIT_TIMEOUT_US 100000
+
+/* RD link health, counted since read_evt_init */
+struct read_evt_rd_health
+{
+  uint32_t nevts;     /* events read */
+  uint32_t nbusy;     /* events for which the RD transfer was not done */
+  uint32_t nspin;     /* ... and which finished while spinning */
+  uint32_t nyield;    /* ... while yielding */
+  uint32_t nsleep;    /* ... while sleeping */
+  uint32_t ntimeout;  /* ... not finished at all (RD missing) */
+  uint32_t nparity0;  /* events with RD_PARITY0 set for their buffer */
+  uint32_t nparity1;  /* events with RD_PARITY1 set for their buffer */
+  uint64_t max_wait_ns;
+};
+
+void read_evt_set_wait(int wait_type,const char *dev);
+struct evt_wait;
+struct evt_wait *read_evt_wait(); /* e.g. to evt_wait_notify it */
+void read_evt_set_rd_wait(const struct read_evt_rd_wait *w); /* NULL: default */
+const struct read_evt_rd_health *read_evt_rd_health();
+/* RD parity errors allowed in a event (rd_parity.h), from read_evt_init */
+void read_evt_set_parity_budget(uint32_t budget);
+/* how the shower and RD buffers are copied (MEM_COPY_*, mem_copy.h) and
+   the device for the DMA copy, from read_evt_init.
+   Default: memcpy for the shower, word by word for the RD. */
+void read_evt_set_copy(int shwr_type,int rd_type,const char *dev);
+void read_evt_rd_health_print(FILE *fp);
+uint32_t volatile *read_evt_regs();
+struct evt_stats *read_evt_stats();
+struct ttag_cal;
+const struct ttag_cal *read_evt_ttag_cal(); /* ttag_cal.h */
+void read_evt_stats_enable(int on);
+
+/* the device context to read from, opened (all the regions) and kept
+   by the caller; by default read_evt_init opens its own (rd_dev.h) */
+void read_evt_set_dev(struct rd_dev *d);
+int read_evt_init(); /* 0 or 1, nothing is left mapped on error */
 int read_evt_end();
-int read_evt_read(struct shwr_evt_raw *shwr);
+int read_evt_read(struct shwr_evt_raw *shwr); /* rd_mem zero if RD missing */
+
+struct evt_lease *read_evt_lease();
+int read_evt_release(struct evt_lease *l);
+/* copy n samples of the raw channel ch (0..SHWR_RAW_NCH_MAX-1) starting
+   first samples after trace_start (it can be negative) */
+int read_evt_lease_window(const struct evt_lease *l,int ch,
+			  int first,int n,uint32_t *dst);
+/* copy the whole event (RD_MEM_WORDS words in rd, zero if RD missing);
+   a lease not paired yet with its RD buffer gets EVT_LEASE_RD_MISSING.
+   return 1, nothing to use, for a lease without EVT_LEASE_META or if
+   the shower copy failed */
+int read_evt_lease_copy(struct evt_lease *l,struct shwr_evt_raw *shwr,
+			uint32_t *rd);
+/* check the parity of the RD words copied from the buffer rd_buf (with
+   the lease rd_status) and count it in the RD health. Meant for the
+   consumer of the copy, after the lease was released; it may run in
+   several threads. return 1 if over the budget (EVT_LEASE_RD_PARITY). */
+int read_evt_rd_check(const uint32_t *rd,int rd_buf,uint32_t rd_status);
+
 void FeShwrRead_test(int nevts);
+
+#endif /*_READ_EVT_H*/
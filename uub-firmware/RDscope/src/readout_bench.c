@@ -0,0 +1,150 @@
+// Readout benchmark without the UUB: read_evt reads the events of the
+// software model of the trigger and RD interface (uub_emu.h), running
+// in a thread over stand-in files in shared memory.
+//
+//   readout_bench [-n events] [-r rate] [-w timer|eventfd]
+//                 [-d rd delay us] [-l rd loss] [-p parity error fraction]
+//                 [-c copy] [-D dir]
+//
+// It prints the events/s read, the dead time (triggers lost with the
+// 4 shower buffers full) and the readout statistics.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "read_evt.h"
+#include "evt_wait.h"
+#include "evt_stats.h"
+#include "mem_copy.h"
+#include "uub_emu.h"
+#include "ttag_cal.h"
+
+#define BENCH_DIR "/dev/shm/readout_bench.XXXXXX"
+
+static struct shwr_evt_raw shwr;
+
+static void bench_notify(void *arg)
+{
+  evt_wait_notify(read_evt_wait());
+}
+
+int main(int argc,char *argv[])
+{
+  char tmp[]=BENCH_DIR;
+  char file[320];
+  struct uub_emu_config cfg;
+  struct uub_emu emu;
+  struct evt_lease *l,done;
+  struct rd_dev dev;
+  const char *dir=NULL;
+  uint64_t t0,t1;
+  int c,r,n,nevts=10000,wait_type=EVT_WAIT_EVENTFD,copy=MEM_COPY_MEMCPY;
+  int ret,ncopy_err=0;
+
+  uub_emu_config_default(&cfg);
+  cfg.rate=1000.;
+  while((c=getopt(argc,argv,"n:r:w:d:l:p:c:D:"))!=-1){
+    switch(c){
+    case 'n':
+      nevts=atoi(optarg);
+      break;
+    case 'r':
+      cfg.rate=atof(optarg);
+      break;
+    case 'w':
+      wait_type=evt_wait_type(optarg);
+      if(wait_type!=EVT_WAIT_TIMER && wait_type!=EVT_WAIT_EVENTFD){
+	printf("readout_bench: -w timer|eventfd\n");
+	return(1);
+      }
+      break;
+    case 'd':
+      cfg.rd_delay_us=atof(optarg);
+      break;
+    case 'l':
+      cfg.rd_loss=atof(optarg);
+      break;
+    case 'p':
+      cfg.parity=atof(optarg);
+      break;
+    case 'c':
+      copy=mem_copy_type(optarg);
+      if(copy<0 || copy==MEM_COPY_DMA){
+	printf("readout_bench: -c word|memcpy|wide|simd\n");
+	return(1);
+      }
+      break;
+    case 'D':
+      dir=optarg;
+      break;
+    default:
+      printf("usage: %s [-n events] [-r rate] [-w timer|eventfd]\n"
+	     "       [-d rd delay us] [-l rd loss] [-p parity error fraction]\n"
+	     "       [-c copy] [-D dir]\n",argv[0]);
+      return(1);
+    }
+  }
+  if(dir==NULL){
+    dir=mkdtemp(tmp);
+    if(dir==NULL){
+      printf("readout_bench: not possible to create %s\n",BENCH_DIR);
+      return(1);
+    }
+  }
+
+  rd_dev_init(&dev);
+  if(rd_dev_open(&dev,dir,RD_DEV_ALL)!=0)
+    return(1);
+  if(wait_type==EVT_WAIT_EVENTFD)
+    cfg.notify=bench_notify;
+  if(uub_emu_init(&emu,&dev,&cfg)!=0)
+    return(1);
+  read_evt_set_dev(&dev);
+  read_evt_set_wait(wait_type,NULL);
+  read_evt_set_copy(copy,copy,NULL);
+  read_evt_stats_enable(1);
+  if(read_evt_init()!=0)
+    return(1);
+  if(uub_emu_start(&emu)!=0)
+    return(1);
+
+  t0=evt_stats_now();
+  for(n=0;n<nevts;n++){
+    l=read_evt_lease();
+    if(l==NULL)
+      break;
+    ret=read_evt_lease_copy(l,&shwr,rd_mem);
+    done=*l;
+    read_evt_release(l);
+    if(ret!=0){
+      ncopy_err++;
+      continue;
+    }
+    /* as a writer does, out of the lease */
+    if(!(done.flags & EVT_LEASE_RD_MISSING))
+      read_evt_rd_check(rd_mem,done.rd_buf,done.rd_status);
+  }
+  t1=evt_stats_now();
+  uub_emu_stop(&emu);
+
+  printf("%d events in %.3f s: %.1f evt/s (trigger rate %.1f Hz)\n",n,
+	 (t1-t0)*1e-9,n/((t1-t0)*1e-9),cfg.rate);
+  if(ncopy_err>0)
+    printf("%d events not copied\n",ncopy_err);
+  uub_emu_print(stdout,&emu);
+  evt_stats_print(stdout,read_evt_stats());
+  read_evt_rd_health_print(stdout);
+  ttag_cal_print(stdout,read_evt_ttag_cal());
+  read_evt_end();
+  rd_dev_close(&dev);
+
+  if(dir==tmp){
+    for(r=0;r<RD_DEV_NREGIONS;r++){
+      snprintf(file,sizeof(file),"%s/%s",dir,rd_dev_region_name(r));
+      unlink(file);
+    }
+    rmdir(dir);
+  }
+  return(0);
+}
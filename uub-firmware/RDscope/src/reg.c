@@ -1,3 +1,30 @@
+// Read/write the SDE trigger registers.
+//
+//   reg <reg> [hex value]          read (and write) one register
+//   reg [-v] [-t] [-a] -f <script> run a script of register operations,
+//                                  "-f -" reads it from stdin
+//
+// <reg> is the register number or its name in sde_trigger_defs.h, with
+// or without the _ADDR suffix (SHWR_BUF_TRIG_MASK = 128).
+// The registers are mapped once (fe_lib.h, rd_dev.h); FE_REGS_FILE names
+// a file which stands in for them out of the UUB, RD_DEV_PATH another
+// device or a directory of stand-in files.
+//
+// Script lines, '#' starts a comment:
+//   w <reg> <hex>                  write
+//   r <reg>                        read and print
+//   or <reg> <hex>                 set bits
+//   and <reg> <hex>                keep bits
+//   sleep <us>
+//   poll <reg> <hex mask> <hex value> [timeout ms]
+//                                  wait for (reg & mask)==value
+//   begin                          the next writes are held ...
+//   commit                         ... and written together here
+//                                  (the trigger mask last)
+// The whole script is checked before anything is written.
+//   -v  read back and check every write
+//   -t  print the time taken by each operation
+//   -a  all the script between a begin and a commit
 #include <stdlib.h>
 #include <sys/select.h>
 #include <stdio.h>
@@ -14,68 +41,360 @@
 #include "xparameters.h"
 #include "xparameters_ps.h"
 #include "sde_trigger_defs.h"
-reg(int argc,char *argv[])
+#include "fe_lib.h"
+#include "reg_names.h"
+
+#define REG_SCRIPT_MAX 1024
+#define REG_POLL_TIMEOUT_MS 1000
+
+enum{
+  REG_OP_WRITE=0,
+  REG_OP_READ,
+  REG_OP_OR,
+  REG_OP_AND,
+  REG_OP_SLEEP,
+  REG_OP_POLL,
+  REG_OP_BEGIN,
+  REG_OP_COMMIT
+};
+
+struct reg_op
 {
-  int fd,size,i;
-  volatile uint32_t *regs;
-  int reg,set;
-  uint32_t val,prev;
+  int op;
+  int line;
+  int reg;
+  uint32_t val;
+  uint32_t mask;
+  uint32_t timeout; /* ms, or us for sleep */
+};
 
-  reg=atoi(argv[1]);
-  if(argc>2){
-    sscanf(argv[2],"%x",&val);
-    set=1;
-  } else {
-    set=0;
+static const char *reg_op_name[]={
+  "w","r","or","and","sleep","poll","begin","commit"
+};
+
+static int reg_parse_reg(const char *s)
+{
+  char *end;
+  long r;
+
+  if(s==NULL)
+    return(-1);
+  r=strtol(s,&end,10);
+  if(*end!='\0')
+    r=reg_name_lookup(s);
+  if(r<0 || r>=FE_NREGS)
+    return(-1);
+  return(r);
+}
+
+static int reg_parse_hex(const char *s,uint32_t *v)
+{
+  char *end;
+
+  if(s==NULL)
+    return(1);
+  *v=strtoul(s,&end,16);
+  return(*end!='\0');
+}
+
+static int reg_parse_line(char *buf,struct reg_op *o)
+{
+  char *tok[5];
+  char *p;
+  int n,i;
+
+  p=strchr(buf,'#');
+  if(p!=NULL)
+    *p='\0';
+  n=0;
+  for(p=strtok(buf," \t\r\n");p!=NULL && n<5;p=strtok(NULL," \t\r\n"))
+    tok[n++]=p;
+  for(i=n;i<5;i++)
+    tok[i]=NULL;
+  if(n==0)
+    return(-1); /* empty */
+
+  for(o->op=0;o->op<=REG_OP_COMMIT;o->op++){
+    if(strcmp(tok[0],reg_op_name[o->op])==0)
+      break;
   }
-  /*open registers address for read/write */
-  fd=open("/dev/mem",O_RDWR);
-  if(fd<0){
-    printf("Error - it was not possible to open the /dev/mem "
-	   "for read/write regitsters\n");
-    exit(1);
+  o->reg=0;
+  o->val=o->mask=0;
+  o->timeout=REG_POLL_TIMEOUT_MS;
+  switch(o->op){
+  case REG_OP_WRITE:
+  case REG_OP_OR:
+  case REG_OP_AND:
+    o->reg=reg_parse_reg(tok[1]);
+    return(o->reg<0 || reg_parse_hex(tok[2],&o->val));
+  case REG_OP_READ:
+    o->reg=reg_parse_reg(tok[1]);
+    return(o->reg<0);
+  case REG_OP_SLEEP:
+    if(tok[1]==NULL)
+      return(1);
+    o->timeout=strtoul(tok[1],&p,10);
+    return(*p!='\0');
+  case REG_OP_POLL:
+    o->reg=reg_parse_reg(tok[1]);
+    if(o->reg<0 || reg_parse_hex(tok[2],&o->mask) ||
+       reg_parse_hex(tok[3],&o->val))
+      return(1);
+    if(tok[4]!=NULL){
+      o->timeout=strtoul(tok[4],&p,10);
+      return(*p!='\0');
+    }
+    return(0);
+  case REG_OP_BEGIN:
+  case REG_OP_COMMIT:
+    return(0);
   }
-  size=256*sizeof(uint32_t);
-  if(size%sysconf(_SC_PAGE_SIZE)){
-    size=(size/sysconf(_SC_PAGE_SIZE)+1)*sysconf(_SC_PAGE_SIZE);
+  return(1);
+}
+
+static double reg_now_us()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return(ts.tv_sec*1e6+ts.tv_nsec*1e-3);
+}
+
+static void reg_print(const char *what,int reg,uint32_t val)
+{
+  const char *name=reg_name_of(reg);
+
+  printf("%s %d%s%s%s = %08x\n",what,reg,name ? " (" : "",name ? name : "",
+	 name ? ")" : "",val);
+}
+
+/* expected is FeGetReg(reg), the shadow of a configuration register.
+   The pulse, status and counter registers do not read back what was
+   written: nothing to check. */
+static int reg_verify(int reg,uint32_t expected)
+{
+  uint32_t v;
+
+  if(!FeRegShadowed(reg)){
+    printf("reg: %d not verifiable (not a configuration register)\n",reg);
+    return(0);
   }
-  regs=(uint32_t *)mmap(NULL, size,
-			PROT_READ | PROT_WRITE, MAP_SHARED,
-			fd,SDE_TRIGGER_BASE);
-  if(regs==MAP_FAILED){
-    printf("Error - while trying to map the Registers\n");
-    exit(1);
+  v=FeReadReg(reg);
+  if(v==expected)
+    return(0);
+  printf("reg: verify error in %d: wrote %08x, read %08x\n",reg,expected,v);
+  return(1);
+}
+
+/* run the script; return the number of errors (verify, poll timeouts) */
+static int reg_run(struct reg_op *ops,int nops,int verify,int timing)
+{
+  int written[FE_NREGS];
+  struct timespec ts;
+  struct reg_op *o;
+  double t0,t1;
+  uint32_t v;
+  int i,r,batch=0,nerr=0;
+
+  memset(written,0,sizeof(written));
+  for(i=0;i<nops;i++){
+    o=&ops[i];
+    t0=reg_now_us();
+    switch(o->op){
+    case REG_OP_WRITE:
+    case REG_OP_OR:
+    case REG_OP_AND:
+      if(o->op==REG_OP_WRITE)
+	FeSetReg(o->reg,o->val);
+      else if(o->op==REG_OP_OR)
+	FeOrReg(o->reg,o->val);
+      else
+	FeAndReg(o->reg,o->val);
+      if(batch)
+	written[o->reg]=1;
+      else if(verify)
+	nerr+=reg_verify(o->reg,FeGetReg(o->reg));
+      break;
+    case REG_OP_READ:
+      reg_print("r",o->reg,FeReadReg(o->reg));
+      break;
+    case REG_OP_SLEEP:
+      ts.tv_sec=o->timeout/1000000;
+      ts.tv_nsec=(o->timeout%1000000)*1000;
+      nanosleep(&ts,NULL);
+      break;
+    case REG_OP_POLL:
+      do {
+	v=FeReadReg(o->reg);
+      } while((v & o->mask)!=o->val && reg_now_us()-t0<o->timeout*1000.);
+      if((v & o->mask)!=o->val){
+	printf("reg: line %d: timeout, register %d = %08x\n",o->line,o->reg,v);
+	nerr++;
+      }
+      break;
+    case REG_OP_BEGIN:
+      FeBegin();
+      batch=1;
+      break;
+    case REG_OP_COMMIT:
+      FeCommit();
+      batch=0;
+      for(r=0;r<FE_NREGS;r++){
+	if(written[r] && verify)
+	  nerr+=reg_verify(r,FeGetReg(r));
+	written[r]=0;
+      }
+      break;
+    }
+    t1=reg_now_us();
+    if(timing)
+      printf("reg: line %d: %s %d: %.1f us\n",o->line,reg_op_name[o->op],
+	     o->reg,t1-t0);
   }
-  close(fd); /*it is not needed to keep opened */
-  prev=regs[reg];
-  if(set){
-    regs[reg]=val;
+  if(batch){
+    FeCommit();
+    for(r=0;r<FE_NREGS;r++){
+      if(written[r] && verify)
+	nerr+=reg_verify(r,FeGetReg(r));
+    }
   }
-  printf("reg: %d -- %08x ... %08x\n",reg,prev,regs[reg]);
-
+  return(nerr);
 }
-//
-//  }
-//
-//SHWR_BUF_TRIG_MASK_ADDR
 
-//COMPATIBILITY_SHWR_BUF_TRIG_SB  ,
+static int reg_script(const char *file,int verify,int timing,int all)
+{
+  static struct reg_op ops[REG_SCRIPT_MAX+2];
+  char buf[256];
+  FILE *fp;
+  double t0;
+  int nops,line,ret,nerr;
 
+  fp=(strcmp(file,"-")==0) ? stdin : fopen(file,"r");
+  if(fp==NULL){
+    printf("Error - it was not possible to open %s\n",file);
+    return(1);
+  }
+  nops=0;
+  line=0;
+  nerr=0;
+  if(all)
+    ops[nops++].op=REG_OP_BEGIN;
+  while(fgets(buf,sizeof(buf),fp)!=NULL){
+    line++;
+    if(nops>REG_SCRIPT_MAX){
+      printf("reg: more than %d operations\n",REG_SCRIPT_MAX);
+      nerr++;
+      break;
+    }
+    ret=reg_parse_line(buf,&ops[nops]);
+    if(ret<0)
+      continue;
+    if(ret>0){
+      printf("reg: %s line %d: not understood\n",file,line);
+      nerr++;
+      continue;
+    }
+    ops[nops++].line=line;
+  }
+  if(fp!=stdin)
+    fclose(fp);
+  if(nerr>0)
+    return(1); /* nothing was written */
+  if(all)
+    ops[nops++].op=REG_OP_COMMIT;
 
-//  COMPATIBILITY_SB_TRIG_THR0_ADDR, 48 800
-//  COMPATIBILITY_SB_TRIG_THR1_ADDR, 49 800
-//  COMPATIBILITY_SB_TRIG_THR2_ADDR, 50 800
-//  COMPATIBILITY_SB_TRIG_ENAB_ADDR, 52 f8
-//  COMPATIBILITY_SB_TRIG_INCL_PMT0,
-//  COMPATIBILITY_SB_TRIG_INCL_PMT1,
-//  COMPATIBILITY_SB_TRIG_INCL_PMT2,
-//  COMPATIBILITY_SB_TRIG_COINC_LVL_SHIFT,
+  t0=reg_now_us();
+  nerr=reg_run(ops,nops,verify,timing);
+  if(timing)
+    printf("reg: %d operations in %.1f us\n",nops,reg_now_us()-t0);
+  return(nerr!=0);
+}
 
-//SHWR_BUF_TRIG_MASK_ADDR 128
+int reg(int argc,char *argv[])
+{
+  int reg,set,c,ret;
+  int verify=0,timing=0,all=0;
+  const char *script=NULL;
+  uint32_t val,prev;
 
+  optind=1;
+  while((c=getopt(argc,argv,"vtaf:"))!=-1){
+    switch(c){
+    case 'v':
+      verify=1;
+      break;
+    case 't':
+      timing=1;
+      break;
+    case 'a':
+      all=1;
+      break;
+    case 'f':
+      script=optarg;
+      break;
+    default:
+      printf("usage: reg <reg> [hex value]\n"
+	     "       reg [-v] [-t] [-a] -f <script>|-\n");
+      return(1);
+    }
+  }
 
-//COMPATIBILITY_GLOBAL_CONTROL_ADDR 46
+  if(script==NULL){
+    if(optind>=argc){
+      printf("usage: reg <reg> [hex value]\n");
+      return(1);
+    }
+    reg=reg_parse_reg(argv[optind]);
+    if(reg<0){
+      printf("reg: unknown register %s\n",argv[optind]);
+      return(1);
+    }
+    set=0;
+    if(optind+1<argc){
+      if(reg_parse_hex(argv[optind+1],&val)){
+	printf("reg: bad value %s\n",argv[optind+1]);
+	return(1);
+      }
+      set=1;
+    }
+  }
 
+  /*open registers address for read/write */
+  if(FeInit(NULL)!=FE_OK)
+    exit(1);
+  if(script!=NULL){
+    ret=reg_script(script,verify,timing,all);
+  } else {
+    prev=FeReadReg(reg);
+    if(set){
+      FeSetReg(reg,val);
+    }
+    printf("reg: %d -- %08x ... %08x\n",reg,prev,FeReadReg(reg));
+    ret=0;
+  }
+  FeEnd();
+  return(ret);
+}
+
+#ifdef REG_MAIN
+/* the reg program (Makefile: reg); nothing else calls reg() */
+int main(int argc,char *argv[])
+{
+  return(reg(argc,argv));
+}
+#endif
+//
+// Trigger setup (compatibility SB trigger, 3 PMTs, coincidence 1),
+// as a script for reg -v -a -f:
+//
+//   w COMPATIBILITY_GLOBAL_CONTROL 1
+//   w COMPATIBILITY_SB_TRIG_THR0 280
+//   w COMPATIBILITY_SB_TRIG_THR1 280
+//   w COMPATIBILITY_SB_TRIG_THR2 280
+//   w COMPATIBILITY_SB_TRIG_ENAB 78
+//   w SHWR_BUF_TRIG_MASK 1
+//
+// which is the same as
 //./reg 46 1
 //./reg 48 280
 //./reg 49 280
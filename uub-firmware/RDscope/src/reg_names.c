@@ -0,0 +1,158 @@
+// Names of the SDE trigger registers (sde_trigger_defs.h), to be given
+// in place of the register numbers to the reg tool.
+#include <string.h>
+#include <strings.h>
+
+#include "xparameters.h"
+#include "sde_trigger_defs.h"
+#include "reg_names.h"
+
+#define REG_NAME(x) {#x,x}
+
+static const struct reg_name reg_names[]={
+  REG_NAME(COMPATIBILITY_AMIGA_TRIG_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_MIN0_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_MIN1_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_MIN2_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_MAX0_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_MAX1_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_MAX2_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_ENAB_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_INT_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_OCC_ADDR),
+  REG_NAME(COMPATIBILITY_MOPS_TRIG_OFS_ADDR),
+  REG_NAME(COMPATIBILITY_TRIG_RATES_ADDR),
+  REG_NAME(COMPATIBILITY_DELAYED_RATES_ADDR),
+  REG_NAME(COMPATIBILITY_GLOBAL_CONTROL_ADDR),
+  REG_NAME(ID_REG_ADDR),
+  REG_NAME(COMPATIBILITY_SB_TRIG_THR0_ADDR),
+  REG_NAME(COMPATIBILITY_SB_TRIG_THR1_ADDR),
+  REG_NAME(COMPATIBILITY_SB_TRIG_THR2_ADDR),
+  REG_NAME(COMPATIBILITY_SB_TRIG_ENAB_ADDR),
+  REG_NAME(COMPATIBILITY_RANDOM_TRIG_DELAY_A_ADDR),
+  REG_NAME(COMPATIBILITY_RANDOM_TRIG_DELAY_B_ADDR),
+  REG_NAME(COMPATIBILITY_RANDOM_TRIG_START_ADDR),
+  REG_NAME(COMPATIBILITY_TOT_TRIG_THR0_ADDR),
+  REG_NAME(COMPATIBILITY_TOT_TRIG_THR1_ADDR),
+  REG_NAME(COMPATIBILITY_TOT_TRIG_THR2_ADDR),
+  REG_NAME(COMPATIBILITY_TOT_TRIG_ENAB_ADDR),
+  REG_NAME(COMPATIBILITY_TOT_TRIG_OCC_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_THR0_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_THR1_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_THR2_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_UP0_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_UP1_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_UP2_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_ENAB_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_OCC_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_FD_ADDR),
+  REG_NAME(COMPATIBILITY_TOTD_TRIG_FN_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_A_THR0_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_A_THR1_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_A_THR2_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_A_ENAB_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_A_COUNT_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_B_THR0_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_B_THR1_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_B_THR2_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_B_ENAB_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_B_COUNT_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_C_THR0_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_C_THR1_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_C_THR2_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_C_ENAB_ADDR),
+  REG_NAME(COMPATIBILITY_SCALAR_C_COUNT_ADDR),
+  REG_NAME(SHWR_BUF_TRIG_MASK_ADDR),
+  REG_NAME(SHWR_BUF_TRIG_ID_ADDR),
+  REG_NAME(SHWR_BUF_CONTROL_ADDR),
+  REG_NAME(SHWR_BUF_STATUS_ADDR),
+  REG_NAME(SHWR_BUF_START_ADDR),
+  REG_NAME(MUON_TRIG1_THR0_ADDR),
+  REG_NAME(MUON_TRIG1_THR1_ADDR),
+  REG_NAME(MUON_TRIG1_THR2_ADDR),
+  REG_NAME(MUON_TRIG1_SSD_ADDR),
+  REG_NAME(MUON_TRIG1_ENAB_ADDR),
+  REG_NAME(MUON_TRIG2_THR0_ADDR),
+  REG_NAME(MUON_TRIG2_THR1_ADDR),
+  REG_NAME(MUON_TRIG2_THR2_ADDR),
+  REG_NAME(MUON_TRIG2_SSD_ADDR),
+  REG_NAME(MUON_TRIG2_ENAB_ADDR),
+  REG_NAME(MUON_TRIG3_THR0_ADDR),
+  REG_NAME(MUON_TRIG3_THR1_ADDR),
+  REG_NAME(MUON_TRIG3_THR2_ADDR),
+  REG_NAME(MUON_TRIG3_SSD_ADDR),
+  REG_NAME(MUON_TRIG3_ENAB_ADDR),
+  REG_NAME(MUON_TRIG4_THR0_ADDR),
+  REG_NAME(MUON_TRIG4_THR1_ADDR),
+  REG_NAME(MUON_TRIG4_THR2_ADDR),
+  REG_NAME(MUON_TRIG4_SSD_ADDR),
+  REG_NAME(MUON_TRIG4_ENAB_ADDR),
+  REG_NAME(MUON_BUF_TIME_TAG_A_ADDR),
+  REG_NAME(MUON_BUF_TIME_TAG_B_ADDR),
+  REG_NAME(MUON_BUF_TRIG_MASK_ADDR),
+  REG_NAME(MUON_BUF_CONTROL_ADDR),
+  REG_NAME(MUON_BUF_STATUS_ADDR),
+  REG_NAME(MUON_BUF_WORD_COUNT_ADDR),
+  REG_NAME(MUON_BUF_WORD_COUNT0_ADDR),
+  REG_NAME(MUON_BUF_WORD_COUNT1_ADDR),
+  REG_NAME(MUON_BUF_WORD_COUNT2_ADDR),
+  REG_NAME(MUON_BUF_WORD_COUNT3_ADDR),
+  REG_NAME(SB_TRIG_THR0_ADDR),
+  REG_NAME(SB_TRIG_THR1_ADDR),
+  REG_NAME(SB_TRIG_THR2_ADDR),
+  REG_NAME(SB_TRIG_SSD_ADDR),
+  REG_NAME(SB_TRIG_ENAB_ADDR),
+  REG_NAME(SHWR_PEAK_AREA0_ADDR),
+  REG_NAME(SHWR_PEAK_AREA1_ADDR),
+  REG_NAME(SHWR_PEAK_AREA2_ADDR),
+  REG_NAME(SHWR_PEAK_AREA3_ADDR),
+  REG_NAME(SHWR_PEAK_AREA4_ADDR),
+  REG_NAME(SHWR_PEAK_AREA5_ADDR),
+  REG_NAME(SHWR_PEAK_AREA6_ADDR),
+  REG_NAME(SHWR_PEAK_AREA7_ADDR),
+  REG_NAME(SHWR_PEAK_AREA8_ADDR),
+  REG_NAME(SHWR_PEAK_AREA9_ADDR),
+  REG_NAME(SHWR_BASELINE0_ADDR),
+  REG_NAME(SHWR_BASELINE1_ADDR),
+  REG_NAME(SHWR_BASELINE2_ADDR),
+  REG_NAME(SHWR_BASELINE3_ADDR),
+  REG_NAME(SHWR_BASELINE4_ADDR),
+  REG_NAME(FILT_PMT0_TEST_ADDR),
+  REG_NAME(FILT_PMT1_TEST_ADDR),
+  REG_NAME(FILT_PMT2_TEST_ADDR),
+  REG_NAME(ADC0_TEST_ADDR),
+  REG_NAME(ADC1_TEST_ADDR),
+  REG_NAME(ADC2_TEST_ADDR),
+  REG_NAME(ADC3_TEST_ADDR),
+  REG_NAME(ADC4_TEST_ADDR),
+  REG_NAME(LED_CONTROL_ADDR),
+  {NULL,0}
+};
+
+/* the name is matched without case, with or without the _ADDR suffix */
+int reg_name_lookup(const char *name)
+{
+  const struct reg_name *r;
+  size_t len;
+
+  len=strlen(name);
+  for(r=reg_names;r->name!=NULL;r++){
+    if(strcasecmp(r->name,name)==0)
+      return(r->addr);
+    if(strlen(r->name)==len+5 && strncasecmp(r->name,name,len)==0 &&
+       strcmp(r->name+len,"_ADDR")==0)
+      return(r->addr);
+  }
+  return(-1);
+}
+
+const char *reg_name_of(int addr)
+{
+  const struct reg_name *r;
+
+  for(r=reg_names;r->name!=NULL;r++){
+    if(r->addr==addr)
+      return(r->name);
+  }
+  return(NULL);
+}
@@ -0,0 +1,13 @@
+#ifndef _REG_NAMES_H
+#define _REG_NAMES_H
+
+struct reg_name
+{
+  const char *name;
+  int addr;
+};
+
+int reg_name_lookup(const char *name); /* -1: unknown */
+const char *reg_name_of(int addr);     /* NULL: no name */
+
+#endif /*_REG_NAMES_H*/
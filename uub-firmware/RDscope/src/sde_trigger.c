@@ -0,0 +1,23 @@
+// User space implementation of the SDE_TRIGGER interrupt API declared in
+// sde_trigger.h. Under Linux baseaddr_p is the virtual address of the
+// interrupt register block, usually the map 0 of the UIO device which
+// owns the sde_trigger interrupt.
+
+#include <stdint.h>
+#include "xparameters.h"
+#include "sde_trigger.h"
+
+void SDE_TRIGGER_EnableInterrupts(void * baseaddr_p, u32 data)
+{
+  uint32_t volatile *intr=(uint32_t volatile *)baseaddr_p;
+
+  intr[SDE_TRIGGER_INTR_EN_OFFSET/4]=data;
+  intr[SDE_TRIGGER_GLOBAL_INTR_EN_OFFSET/4]=(data!=0);
+}
+
+void SDE_TRIGGER_ACK(void * baseaddr_p, u32 data)
+{
+  uint32_t volatile *intr=(uint32_t volatile *)baseaddr_p;
+
+  intr[SDE_TRIGGER_INTR_ACK_OFFSET/4]=data;
+}
@@ -22,6 +22,8 @@ struct shwr_gps_info
 {
   uint32_t second;
   uint32_t ticks;
+  uint32_t nanosec; /* after the second, calibrated with the PPS */
+  uint32_t pps_cal; /* clock ticks of the second, 0: nanosec not reliable */
 };
 
 struct shwr_evt
@@ -0,0 +1,106 @@
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SHWR_UNPACK_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SHWR_UNPACK_SSE2
+#endif
+
+#include "shwr_unpack.h"
+
+void shwr_unpack_words_scalar(const uint32_t *src,uint16_t *lo,uint16_t *hi,
+			      int n)
+{
+  int i;
+
+  for(i=0;i<n;i++){
+    lo[i]=src[i] & SHWR_ADC_MASK;
+    hi[i]=(src[i]>>16) & SHWR_ADC_MASK;
+  }
+}
+
+void shwr_unpack_words(const uint32_t *src,uint16_t *lo,uint16_t *hi,int n)
+{
+  int i=0;
+
+#if defined(SHWR_UNPACK_NEON)
+  const uint16x8_t mask=vdupq_n_u16(SHWR_ADC_MASK);
+  uint16x8x2_t v;
+
+  /* the load splits the low and high half words of 8 words */
+  for(;i+8<=n;i+=8){
+    v=vld2q_u16((const uint16_t *)(src+i));
+    vst1q_u16(lo+i,vandq_u16(v.val[0],mask));
+    vst1q_u16(hi+i,vandq_u16(v.val[1],mask));
+  }
+#elif defined(SHWR_UNPACK_SSE2)
+  const __m128i mask=_mm_set1_epi32(SHWR_ADC_MASK);
+  __m128i a,b;
+
+  /* the values fit in 12 bits, so the signed pack does not saturate */
+  for(;i+8<=n;i+=8){
+    a=_mm_loadu_si128((const __m128i *)(src+i));
+    b=_mm_loadu_si128((const __m128i *)(src+i+4));
+    _mm_storeu_si128((__m128i *)(lo+i),
+		     _mm_packs_epi32(_mm_and_si128(a,mask),
+				     _mm_and_si128(b,mask)));
+    _mm_storeu_si128((__m128i *)(hi+i),
+		     _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a,16),mask),
+				     _mm_and_si128(_mm_srli_epi32(b,16),mask)));
+  }
+#endif
+  shwr_unpack_words_scalar(src+i,lo+i,hi+i,n-i);
+}
+
+const char *shwr_unpack_impl()
+{
+#if defined(SHWR_UNPACK_NEON)
+  return("neon");
+#elif defined(SHWR_UNPACK_SSE2)
+  return("sse2");
+#else
+  return("scalar");
+#endif
+}
+
+void shwr_unpack_window(const uint32_t *raw,int trace_start,int first,
+			int n,uint16_t *lo,uint16_t *hi)
+{
+  int start,n1;
+
+  /* at most two straight copies: from the window start to the end of
+     the memory, then from its beginning */
+  start=(trace_start+first)%SHWR_NSAMPLES;
+  if(start<0)
+    start+=SHWR_NSAMPLES;
+  n1=SHWR_NSAMPLES-start;
+  if(n1>n)
+    n1=n;
+  shwr_unpack_words(raw+start,lo,hi,n1);
+  shwr_unpack_words(raw,lo+n1,hi+n1,n-n1);
+}
+
+void shwr_unpack_channel(const uint32_t *raw,int trace_start,
+			 uint16_t *lo,uint16_t *hi)
+{
+  shwr_unpack_window(raw,trace_start,0,SHWR_NSAMPLES,lo,hi);
+}
+
+void shwr_evt_unpack(const struct shwr_evt_raw *raw,struct shwr_evt *evt)
+{
+  int i;
+
+  evt->Evt_type_1=raw->Evt_type_1;
+  evt->Evt_type_2=raw->Evt_type_2;
+  evt->ev_gps_info=raw->ev_gps_info;
+  evt->micro_off=0;
+  evt->nsamples=SHWR_NSAMPLES;
+
+  for(i=0;i<SHWR_RAW_NCH_MAX;i++){
+    shwr_unpack_channel(raw->fadc_raw[i],raw->trace_start,
+			evt->fadcs+(2*i)*SHWR_NSAMPLES,
+			evt->fadcs+(2*i+1)*SHWR_NSAMPLES);
+  }
+}
@@ -0,0 +1,37 @@
+/* Conversion of the raw shower event (struct shwr_evt_raw: two 12 bits
+   ADC in each word of fadc_raw, the buffer starting anywhere) to the
+   unpacked one (struct shwr_evt): fadcs holds the SHWR_NCH_MAX
+   channels one after the other, SHWR_NSAMPLES each, already rotated
+   so the sample 0 is the one at trace_start. Channel 2*i is the low
+   gain (bits 0..11) and 2*i+1 the high gain (bits 16..27) of the raw
+   channel i, as in the JSON output.
+
+   The deinterleave uses NEON (ARM) or SSE2 (x86) when the compiler
+   has them, plain C otherwise.
+*/
+
+#ifndef _SHWR_UNPACK_H
+#define _SHWR_UNPACK_H
+
+#include <stdint.h>
+#include "shwr_evt_defs.h"
+
+#define SHWR_ADC_MASK 0xfff
+
+void shwr_evt_unpack(const struct shwr_evt_raw *raw,struct shwr_evt *evt);
+/* one raw channel (SHWR_NSAMPLES words) rotated by trace_start */
+void shwr_unpack_channel(const uint32_t *raw,int trace_start,
+			 uint16_t *lo,uint16_t *hi);
+/* only the samples first..first+n-1 (n<=SHWR_NSAMPLES) of the rotated
+   channel */
+void shwr_unpack_window(const uint32_t *raw,int trace_start,int first,
+			int n,uint16_t *lo,uint16_t *hi);
+
+/* n words of src to lo (bits 0..11) and hi (bits 16..27) */
+void shwr_unpack_words(const uint32_t *src,uint16_t *lo,uint16_t *hi,int n);
+void shwr_unpack_words_scalar(const uint32_t *src,uint16_t *lo,uint16_t *hi,
+			      int n);
+
+const char *shwr_unpack_impl(); /* "neon", "sse2" or "scalar" */
+
+#endif /*_SHWR_UNPACK_H*/
@@ -0,0 +1,91 @@
+// Micro benchmark of the shower event unpack (shwr_unpack.h) against
+// the per sample loop used by the scope output.
+//
+//   shwr_unpack_bench [-n iterations]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shwr_unpack.h"
+
+static struct shwr_evt_raw raw;
+static struct shwr_evt evt_ref,evt;
+
+static double now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return(ts.tv_sec+ts.tv_nsec*1e-9);
+}
+
+/* the loop as it is done sample by sample in the output code */
+static void unpack_loop(const struct shwr_evt_raw *r,struct shwr_evt *e)
+{
+  int i,j,index;
+  uint32_t word;
+
+  for(j=0;j<SHWR_NSAMPLES;j++){
+    index=(j+r->trace_start)%SHWR_NSAMPLES;
+    for(i=0;i<SHWR_RAW_NCH_MAX;i++){
+      word=r->fadc_raw[i][index];
+      e->fadcs[(2*i)*SHWR_NSAMPLES+j]=word & 0xFFF;
+      e->fadcs[(2*i+1)*SHWR_NSAMPLES+j]=(word>>16) & 0xFFF;
+    }
+  }
+}
+
+int main(int argc,char *argv[])
+{
+  double t0,t_loop,t_unpack;
+  int i,j,c,niter=10000;
+
+  while((c=getopt(argc,argv,"n:"))!=-1){
+    switch(c){
+    case 'n':
+      niter=atoi(optarg);
+      break;
+    default:
+      printf("usage: %s [-n iterations]\n",argv[0]);
+      return(1);
+    }
+  }
+  if(niter<1)
+    niter=1;
+
+  srand(1);
+  for(i=0;i<SHWR_RAW_NCH_MAX;i++){
+    for(j=0;j<SHWR_NSAMPLES;j++)
+      raw.fadc_raw[i][j]=((uint32_t)rand()<<1) ^ rand();
+  }
+  raw.trace_start=1234;
+
+  unpack_loop(&raw,&evt_ref);
+  shwr_evt_unpack(&raw,&evt);
+  if(memcmp(evt_ref.fadcs,evt.fadcs,sizeof(evt.fadcs))!=0){
+    printf("shwr_unpack_bench: the unpack does not match the loop\n");
+    return(1);
+  }
+
+  t0=now();
+  for(i=0;i<niter;i++){
+    raw.trace_start=i%SHWR_NSAMPLES;
+    unpack_loop(&raw,&evt_ref);
+  }
+  t_loop=(now()-t0)/niter;
+
+  t0=now();
+  for(i=0;i<niter;i++){
+    raw.trace_start=i%SHWR_NSAMPLES;
+    shwr_evt_unpack(&raw,&evt);
+  }
+  t_unpack=(now()-t0)/niter;
+
+  printf("per sample loop : %8.2f us/event\n",t_loop*1e6);
+  printf("unpack (%-6s) : %8.2f us/event  (x%.1f)\n",shwr_unpack_impl(),
+	 t_unpack*1e6,t_loop/t_unpack);
+  return(0);
+}
@@ -0,0 +1,318 @@
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TRACE_PACK_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TRACE_PACK_SSE2
+#endif
+
+#include "trace_pack.h"
+
+#define LANES 4
+#define LANE_N (TRACE_PACK_BLOCK/LANES) /* values in each lane */
+#define BLOCK_MAX (4+LANES*16*4)        /* bytes of a 16 bits block */
+
+static void put32(uint8_t *p,uint32_t v)
+{
+  memcpy(p,&v,4); /* little endian on the UUB and on x86 */
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+  uint32_t v;
+
+  memcpy(&v,p,4);
+  return(v);
+}
+
+static int bits(uint32_t v)
+{
+  int b=0;
+
+  while(v!=0){
+    b++;
+    v>>=1;
+  }
+  return(b);
+}
+
+size_t trace_pack_bound(int narrays,int n)
+{
+  int nblocks=(n+TRACE_PACK_BLOCK-1)/TRACE_PACK_BLOCK;
+
+  return(4*(2*narrays+2)+2*narrays*(4+(size_t)nblocks*BLOCK_MAX));
+}
+
+/* one stream: the 16 bits at shift of the n words of src */
+static size_t pack_stream(const uint32_t *src,int n,int shift,uint8_t *dst,
+			  size_t size)
+{
+  uint32_t zz[TRACE_PACK_BLOCK],words[LANES*16];
+  uint32_t min,max,v,prev;
+  int16_t d;
+  size_t pos;
+  int b,i,k,w,lane,bit,sh,idx;
+
+  if(size<4)
+    return(0);
+  prev=(n>0) ? (src[0]>>shift) & 0xffff : 0;
+  dst[0]=n & 0xff;
+  dst[1]=n>>8;
+  dst[2]=prev & 0xff;
+  dst[3]=prev>>8;
+  pos=4;
+  for(b=0;b<n;b+=TRACE_PACK_BLOCK){
+    min=0xffff;
+    max=0;
+    for(i=0;i<TRACE_PACK_BLOCK && b+i<n;i++){
+      v=(src[b+i]>>shift) & 0xffff;
+      d=(int16_t)(v-prev);
+      zz[i]=(uint16_t)((d<<1) ^ (d>>15));
+      prev=v;
+      if(zz[i]<min)
+	min=zz[i];
+      if(zz[i]>max)
+	max=zz[i];
+    }
+    for(;i<TRACE_PACK_BLOCK;i++)
+      zz[i]=min; /* padding of the last block */
+    w=bits(max-min);
+    if(pos+4+LANES*w*4>size)
+      return(0);
+    put32(dst+pos,w | (min<<8));
+    pos+=4;
+    if(w==0)
+      continue;
+    memset(words,0,LANES*w*4);
+    for(i=0;i<TRACE_PACK_BLOCK;i++){
+      lane=i%LANES;
+      idx=i/LANES;
+      bit=idx*w;
+      k=bit>>5;
+      sh=bit&31;
+      v=zz[i]-min;
+      words[k*LANES+lane]|=v<<sh;
+      if(sh+w>32)
+	words[(k+1)*LANES+lane]|=v>>(32-sh);
+    }
+    for(i=0;i<LANES*w;i++)
+      put32(dst+pos+4*i,words[i]);
+    pos+=LANES*w*4;
+  }
+  return(pos);
+}
+
+size_t trace_pack(const uint32_t *const src[],const int n[],int narrays,
+		  void *dst,size_t size)
+{
+  uint8_t *p=dst;
+  size_t pos,len;
+  int i,s,nstreams=2*narrays;
+
+  pos=4*(nstreams+2);
+  if(pos>size)
+    return(0);
+  put32(p,nstreams);
+  for(i=0;i<narrays;i++){
+    if(n[i]<0 || n[i]>TRACE_PACK_MAX_N)
+      return(0);
+    for(s=0;s<2;s++){
+      put32(p+4*(1+2*i+s),pos);
+      len=pack_stream(src[i],n[i],16*s,p+pos,size-pos);
+      if(len==0)
+	return(0);
+      pos+=len;
+    }
+  }
+  put32(p+4*(1+nstreams),pos);
+  return(pos);
+}
+
+/* the values of a block, delta decoded: out[i]=prev+delta */
+static uint32_t unpack_block(const uint8_t *in,int w,uint32_t min,
+			     uint32_t prev,uint16_t *out)
+{
+  int i,bit,k,sh;
+#if defined(TRACE_PACK_NEON)
+  const uint32x4_t mask=vdupq_n_u32(w<32 ? (1U<<w)-1 : 0xffffffff);
+  const uint32x4_t vmin=vdupq_n_u32(min);
+  const uint32x4_t one=vdupq_n_u32(1);
+  const uint32x4_t zero=vdupq_n_u32(0);
+  uint32x4_t v,lo,hi,carry=vdupq_n_u32(prev);
+  int32x4_t d;
+
+  for(i=0;i<LANE_N;i++){
+    if(w==0){
+      v=vmin;
+    } else {
+      bit=i*w;
+      k=bit>>5;
+      sh=bit&31;
+      lo=vld1q_u32((const uint32_t *)(in+16*k));
+      v=vshlq_u32(lo,vdupq_n_s32(-sh));
+      if(sh+w>32){
+	hi=vld1q_u32((const uint32_t *)(in+16*(k+1)));
+	v=vorrq_u32(v,vshlq_u32(hi,vdupq_n_s32(32-sh)));
+      }
+      v=vaddq_u32(vandq_u32(v,mask),vmin);
+    }
+    /* zigzag back, then the prefix sum of the 4 lanes plus the carry */
+    d=vreinterpretq_s32_u32(veorq_u32(vshrq_n_u32(v,1),
+				      vsubq_u32(zero,vandq_u32(v,one))));
+    d=vaddq_s32(d,vreinterpretq_s32_u32(vextq_u32(zero,
+						   vreinterpretq_u32_s32(d),3)));
+    d=vaddq_s32(d,vreinterpretq_s32_u32(vextq_u32(zero,
+						   vreinterpretq_u32_s32(d),2)));
+    v=vaddq_u32(vreinterpretq_u32_s32(d),carry);
+    carry=vdupq_n_u32(vgetq_lane_u32(v,3));
+    vst1_u16(out+LANES*i,vmovn_u32(v));
+  }
+  return(vgetq_lane_u32(carry,0) & 0xffff);
+#elif defined(TRACE_PACK_SSE2)
+  const __m128i mask=_mm_set1_epi32(w<32 ? (1U<<w)-1 : 0xffffffff);
+  const __m128i vmin=_mm_set1_epi32(min);
+  const __m128i one=_mm_set1_epi32(1);
+  const __m128i zero=_mm_setzero_si128();
+  __m128i v,d,carry=_mm_set1_epi32(prev);
+  uint32_t tmp[LANES];
+  int j;
+
+  for(i=0;i<LANE_N;i++){
+    if(w==0){
+      v=vmin;
+    } else {
+      bit=i*w;
+      k=bit>>5;
+      sh=bit&31;
+      v=_mm_srl_epi32(_mm_loadu_si128((const __m128i *)(in+16*k)),
+		      _mm_cvtsi32_si128(sh));
+      if(sh+w>32)
+	v=_mm_or_si128(v,_mm_sll_epi32(
+			 _mm_loadu_si128((const __m128i *)(in+16*(k+1))),
+			 _mm_cvtsi32_si128(32-sh)));
+      v=_mm_add_epi32(_mm_and_si128(v,mask),vmin);
+    }
+    /* zigzag back, then the prefix sum of the 4 lanes plus the carry */
+    d=_mm_xor_si128(_mm_srli_epi32(v,1),
+		    _mm_sub_epi32(zero,_mm_and_si128(v,one)));
+    d=_mm_add_epi32(d,_mm_slli_si128(d,4));
+    d=_mm_add_epi32(d,_mm_slli_si128(d,8));
+    v=_mm_add_epi32(d,carry);
+    carry=_mm_shuffle_epi32(v,0xff);
+    _mm_storeu_si128((__m128i *)tmp,v);
+    for(j=0;j<LANES;j++)
+      out[LANES*i+j]=tmp[j];
+  }
+  return(_mm_cvtsi128_si32(carry) & 0xffff);
+#else
+  uint32_t v,lane;
+  int j;
+
+  for(i=0;i<LANE_N;i++){
+    bit=i*w;
+    k=bit>>5;
+    sh=bit&31;
+    for(j=0;j<LANES;j++){
+      v=0;
+      if(w>0){
+	lane=get32(in+16*k+4*j);
+	v=lane>>sh;
+	if(sh+w>32)
+	  v|=get32(in+16*(k+1)+4*j)<<(32-sh);
+	v&=(1U<<w)-1;
+      }
+      v+=min;
+      prev=(prev+((v>>1) ^ -(v&1))) & 0xffff;
+      out[LANES*i+j]=prev;
+    }
+  }
+  return(prev);
+#endif
+}
+
+/* one stream into the 16 bits at shift of dst; return n, -1 on error */
+static int unpack_stream(const uint8_t *in,size_t size,int shift,
+			 uint32_t *dst,int max)
+{
+  uint16_t vals[TRACE_PACK_BLOCK];
+  uint32_t hdr,prev;
+  size_t pos;
+  int n,b,i,w,m;
+
+  if(size<4)
+    return(-1);
+  n=in[0] | (in[1]<<8);
+  prev=in[2] | (in[3]<<8);
+  if(n>max)
+    return(-1);
+  pos=4;
+  for(b=0;b<n;b+=TRACE_PACK_BLOCK){
+    if(pos+4>size)
+      return(-1);
+    hdr=get32(in+pos);
+    pos+=4;
+    w=hdr & 0xff;
+    if(w>16 || pos+LANES*w*4>size)
+      return(-1);
+    prev=unpack_block(in+pos,w,hdr>>8,prev,vals);
+    pos+=LANES*w*4;
+    m=(n-b<TRACE_PACK_BLOCK) ? n-b : TRACE_PACK_BLOCK;
+    if(shift==0){
+      for(i=0;i<m;i++)
+	dst[b+i]=vals[i];
+    } else {
+      for(i=0;i<m;i++)
+	dst[b+i]|=(uint32_t)vals[i]<<16;
+    }
+  }
+  return(n);
+}
+
+int trace_pack_narrays(const void *src,size_t size)
+{
+  const uint8_t *p=src;
+  uint32_t nstreams;
+
+  if(size<4)
+    return(-1);
+  nstreams=get32(p);
+  if(nstreams%2!=0 || 4*(nstreams+2)>size)
+    return(-1);
+  return(nstreams/2);
+}
+
+int trace_unpack(const void *src,size_t size,int i,uint32_t *dst,int max)
+{
+  const uint8_t *p=src;
+  uint32_t a,b,c;
+  int narrays,n0,n1;
+
+  narrays=trace_pack_narrays(src,size);
+  if(i<0 || i>=narrays)
+    return(-1);
+  a=get32(p+4*(1+2*i));
+  b=get32(p+4*(2+2*i));
+  c=get32(p+4*(3+2*i));
+  if(a>b || b>c || c>size)
+    return(-1);
+  n0=unpack_stream(p+a,b-a,0,dst,max);
+  if(n0<0)
+    return(-1);
+  n1=unpack_stream(p+b,c-b,16,dst,max);
+  if(n1!=n0)
+    return(-1);
+  return(n0);
+}
+
+const char *trace_pack_impl()
+{
+#if defined(TRACE_PACK_NEON)
+  return("neon");
+#elif defined(TRACE_PACK_SSE2)
+  return("sse2");
+#else
+  return("scalar");
+#endif
+}
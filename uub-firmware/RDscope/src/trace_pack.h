@@ -0,0 +1,45 @@
+/* Lossless compression of the raw traces (shower fadc_raw channels and
+   RD words) for the event files.
+
+   Each array of 32 bits words is split in two streams of 16 bits (low
+   and high half words: the two ADC of a shower word, the two RD
+   channels with their parity bit), so every bit is kept. Each stream
+   is delta coded (zigzag, modulo 2^16) and bit packed in blocks of
+   TRACE_PACK_BLOCK values with a frame of reference: the block
+   minimum and the bit width of the block. The values of a block are
+   stored in 4 interleaved lanes of 32 bits words, so the decode takes
+   4 values at a time with NEON or SSE2.
+
+   Packed layout (little endian):
+     uint32_t nstreams;            2 for each array
+     uint32_t offset[nstreams+1];  of each stream, from the start
+     streams: uint16_t n, uint16_t first value, then the blocks:
+       uint32_t width | (minimum<<8), width*4 words of values
+   Any array can be unpacked alone (trace_unpack).
+*/
+
+#ifndef _TRACE_PACK_H
+#define _TRACE_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_PACK_BLOCK 128
+#define TRACE_PACK_MAX_N 65535
+
+/* bytes needed at most to pack narrays arrays of up to n words */
+size_t trace_pack_bound(int narrays,int n);
+
+/* pack src[i] (n[i] words each); return the packed size, or 0 if it
+   does not fit in size */
+size_t trace_pack(const uint32_t *const src[],const int n[],int narrays,
+		  void *dst,size_t size);
+
+int trace_pack_narrays(const void *src,size_t size); /* -1: not valid */
+/* unpack the array i into dst (up to max words); return the number of
+   words, or -1 on error */
+int trace_unpack(const void *src,size_t size,int i,uint32_t *dst,int max);
+
+const char *trace_pack_impl(); /* decode: "neon", "sse2" or "scalar" */
+
+#endif /*_TRACE_PACK_H*/
@@ -0,0 +1,190 @@
+// Compression ratio and speed of the trace packing (trace_pack.h), on
+// a synthetic event or on the records of an event file, with a check
+// that every record comes back bit for bit.
+//
+//   trace_pack_bench [-n iterations] [-f events.bin]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "evt_file.h"
+#include "read_evt.h"
+#include "trace_pack.h"
+
+#define NARRAYS (SHWR_RAW_NCH_MAX+1)
+
+static uint32_t fadc_raw[SHWR_RAW_NCH_MAX][SHWR_NSAMPLES];
+static uint32_t rd[RD_MEM_WORDS];
+static uint32_t check[RD_MEM_WORDS>SHWR_NSAMPLES ? RD_MEM_WORDS :
+		      SHWR_NSAMPLES];
+
+static double now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return(ts.tv_sec+ts.tv_nsec*1e-9);
+}
+
+static int noise(int sigma)
+{
+  return((rand()%(2*sigma+1)+rand()%(2*sigma+1))/2-sigma);
+}
+
+static uint32_t odd_parity(uint32_t v)
+{
+  return(!__builtin_parity(v));
+}
+
+/* baseline and noise, a pulse in the shower channels; 12 bits RD
+   samples with their parity bit */
+static void synth_event()
+{
+  int i,j,a,b;
+  double pulse;
+
+  for(j=0;j<SHWR_NSAMPLES;j++){
+    pulse=0;
+    if(j>=600 && j<610)
+      pulse=200.*(j-600);
+    else if(j>=610 && j<800)
+      pulse=20000./(j-600);
+    for(i=0;i<SHWR_RAW_NCH_MAX;i++){
+      a=250+noise(3)+(int)(pulse/(i+1));
+      b=250+noise(3)+(int)(pulse/(i+1)/32);
+      if(a>4095)
+	a=4095;
+      fadc_raw[i][j]=(a & 0xfff) | ((b & 0xfff)<<16);
+    }
+  }
+  for(j=0;j<RD_MEM_WORDS;j++){
+    a=2048+noise(20);
+    b=2048+noise(20);
+    rd[j]=odd_parity(a) | (a<<1) | (odd_parity(b)<<16) | (b<<17);
+  }
+}
+
+/* pack and unpack the current event; 0 if it comes back the same */
+static int round_trip(void *buf,size_t size,size_t *len)
+{
+  const uint32_t *src[NARRAYS];
+  int n[NARRAYS];
+  int i;
+
+  for(i=0;i<SHWR_RAW_NCH_MAX;i++){
+    src[i]=fadc_raw[i];
+    n[i]=SHWR_NSAMPLES;
+  }
+  src[i]=rd;
+  n[i]=RD_MEM_WORDS;
+  *len=trace_pack(src,n,NARRAYS,buf,size);
+  if(*len==0)
+    return(1);
+  for(i=0;i<NARRAYS;i++){
+    if(trace_unpack(buf,*len,i,check,n[i])!=n[i] ||
+       memcmp(check,src[i],n[i]*sizeof(uint32_t))!=0)
+      return(1);
+  }
+  return(0);
+}
+
+int main(int argc,char *argv[])
+{
+  struct evt_file_hdr h;
+  const uint32_t *src[NARRAYS];
+  int n[NARRAYS];
+  const char *path=NULL;
+  FILE *fp;
+  void *buf;
+  size_t size,len,raw_size;
+  uint64_t nraw=0,npacked=0;
+  double t0,t_pack,t_unpack;
+  int i,c,ret,nrec=0,niter=1000;
+
+  while((c=getopt(argc,argv,"n:f:"))!=-1){
+    switch(c){
+    case 'n':
+      niter=atoi(optarg);
+      break;
+    case 'f':
+      path=optarg;
+      break;
+    default:
+      printf("usage: %s [-n iterations] [-f events.bin]\n",argv[0]);
+      return(1);
+    }
+  }
+  if(niter<1)
+    niter=1;
+  size=trace_pack_bound(NARRAYS,RD_MEM_WORDS>SHWR_NSAMPLES ? RD_MEM_WORDS :
+			SHWR_NSAMPLES);
+  buf=malloc(size);
+  if(buf==NULL)
+    return(1);
+  raw_size=sizeof(fadc_raw)+sizeof(rd);
+
+  if(path!=NULL){
+    fp=fopen(path,"rb");
+    if(fp==NULL){
+      perror(path);
+      return(1);
+    }
+    memset(rd,0,sizeof(rd));
+    while((ret=evt_file_read(fp,&h,fadc_raw,rd,RD_MEM_WORDS))==0){
+      if(round_trip(buf,size,&len)!=0){
+	printf("trace_pack_bench: record %d does not come back the same\n",
+	       nrec);
+	return(1);
+      }
+      nraw+=raw_size;
+      npacked+=len;
+      nrec++;
+    }
+    fclose(fp);
+    if(ret>0 || nrec==0){
+      printf("trace_pack_bench: no records read from %s\n",path);
+      return(1);
+    }
+    printf("%d records: %llu bytes packed in %llu (ratio %.2f)\n",nrec,
+	   (unsigned long long)nraw,(unsigned long long)npacked,
+	   (double)nraw/npacked);
+  } else {
+    srand(1);
+    synth_event();
+  }
+
+  /* speed on the last event */
+  if(round_trip(buf,size,&len)!=0){
+    printf("trace_pack_bench: the event does not come back the same\n");
+    return(1);
+  }
+  for(i=0;i<SHWR_RAW_NCH_MAX;i++){
+    src[i]=fadc_raw[i];
+    n[i]=SHWR_NSAMPLES;
+  }
+  src[i]=rd;
+  n[i]=RD_MEM_WORDS;
+
+  t0=now();
+  for(c=0;c<niter;c++)
+    trace_pack(src,n,NARRAYS,buf,size);
+  t_pack=(now()-t0)/niter;
+  t0=now();
+  for(c=0;c<niter;c++){
+    for(i=0;i<NARRAYS;i++)
+      trace_unpack(buf,len,i,check,n[i]);
+  }
+  t_unpack=(now()-t0)/niter;
+
+  printf("event: %zu bytes packed in %zu (ratio %.2f)\n",raw_size,len,
+	 (double)raw_size/len);
+  printf("pack           : %8.2f us/event %8.1f MB/s\n",t_pack*1e6,
+	 raw_size/t_pack*1e-6);
+  printf("unpack (%-6s) : %8.2f us/event %8.1f MB/s\n",trace_pack_impl(),
+	 t_unpack*1e6,raw_size/t_unpack*1e-6);
+  free(buf);
+  return(0);
+}
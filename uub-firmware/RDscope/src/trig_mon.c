@@ -0,0 +1,308 @@
+// Trigger rate and scaler monitor (trig_mon.h).
+//
+//   trig_mon [-p period ms] [-w window] [-s shm name] [-D path] [-n samples]
+//            [-v]                  sample and publish (-v: print each one)
+//   trig_mon -r [-j] [-s shm name] print the published rates (-j: JSON)
+//
+// built on its own with TRIG_MON_MAIN.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "xparameters.h"
+#include "sde_trigger_defs.h"
+#include "time_tagging.h"
+#include "trig_mon.h"
+
+#define TRIG_MON_MASK ((uint32_t)((1ULL<<TRIG_MON_WIDTH)-1))
+#define TRIG_MON_READ_TRIES 100
+
+static const char *ctr_name[TRIG_MON_NCTR]={
+  "trig_rates","delayed_rates","scaler_a","scaler_b","scaler_c","dead"
+};
+
+const char *trig_mon_name(int ctr)
+{
+  if(ctr<0 || ctr>=TRIG_MON_NCTR)
+    return("?");
+  return(ctr_name[ctr]);
+}
+
+static void mon_read(const struct trig_mon *m,uint32_t *raw)
+{
+  raw[TRIG_MON_RATES]=m->regs[COMPATIBILITY_TRIG_RATES_ADDR];
+  raw[TRIG_MON_DELAYED]=m->regs[COMPATIBILITY_DELAYED_RATES_ADDR];
+  raw[TRIG_MON_SCALER_A]=m->regs[COMPATIBILITY_SCALAR_A_COUNT_ADDR];
+  raw[TRIG_MON_SCALER_B]=m->regs[COMPATIBILITY_SCALAR_B_COUNT_ADDR];
+  raw[TRIG_MON_SCALER_C]=m->regs[COMPATIBILITY_SCALAR_C_COUNT_ADDR];
+  raw[TRIG_MON_DEAD]=m->ttag[TTAG_DEAD_CTR_ADDR];
+}
+
+int trig_mon_init(struct trig_mon *m,const struct rd_dev *d,
+		  uint32_t period_ms,int window)
+{
+  if(d->ptr[RD_DEV_REGS]==NULL || d->ptr[RD_DEV_TTAG]==NULL){
+    printf("trig_mon: the trigger and time tagging registers are not "
+	   "mapped\n");
+    return(1);
+  }
+  memset(m,0,sizeof(*m));
+  m->regs=d->ptr[RD_DEV_REGS];
+  m->ttag=d->ptr[RD_DEV_TTAG];
+  m->period_ms=period_ms;
+  if(window<1)
+    window=1;
+  if(window>=TRIG_MON_NSAMPLES)
+    window=TRIG_MON_NSAMPLES-1;
+  m->window=window;
+  mon_read(m,m->last);
+  return(0);
+}
+
+void trig_mon_sample(struct trig_mon *m,uint64_t t_ns)
+{
+  struct trig_mon_sample *s;
+  uint32_t raw[TRIG_MON_NCTR];
+  int i;
+
+  mon_read(m,raw);
+  for(i=0;i<TRIG_MON_NCTR;i++){
+    m->count[i]+=(raw[i]-m->last[i]) & TRIG_MON_MASK;
+    m->last[i]=raw[i];
+  }
+  s=&m->ring[m->head];
+  s->t_ns=t_ns;
+  memcpy(s->count,m->count,sizeof(s->count));
+  m->head=(m->head+1)%TRIG_MON_NSAMPLES;
+  if(m->n<TRIG_MON_NSAMPLES)
+    m->n++;
+  m->nsamples++;
+}
+
+int trig_mon_rate(const struct trig_mon *m,int ctr,int n,double *rate)
+{
+  const struct trig_mon_sample *a,*b;
+
+  if(n<1 || n>=m->n)
+    return(1);
+  b=&m->ring[(m->head+TRIG_MON_NSAMPLES-1)%TRIG_MON_NSAMPLES];
+  a=&m->ring[(m->head+TRIG_MON_NSAMPLES-1-n)%TRIG_MON_NSAMPLES];
+  if(b->t_ns<=a->t_ns)
+    return(1);
+  *rate=(b->count[ctr]-a->count[ctr])*1e9/(b->t_ns-a->t_ns);
+  return(0);
+}
+
+int trig_mon_publish_open(struct trig_mon *m,const char *name)
+{
+  void *p;
+  int fd;
+
+  if(name==NULL)
+    name=TRIG_MON_SHM;
+  fd=shm_open(name,O_CREAT | O_RDWR,0644);
+  if(fd<0){
+    printf("Error - it was not possible to open the shared memory %s\n",
+	   name);
+    return(1);
+  }
+  if(ftruncate(fd,sizeof(struct trig_mon_shm))!=0){
+    printf("Error - it was not possible to size %s\n",name);
+    close(fd);
+    return(1);
+  }
+  p=mmap(NULL,sizeof(struct trig_mon_shm),PROT_READ | PROT_WRITE,
+	 MAP_SHARED,fd,0);
+  close(fd);
+  if(p==MAP_FAILED){
+    printf("Error - while trying to map %s\n",name);
+    return(1);
+  }
+  m->shm=p;
+  strncpy(m->shm_name,name,sizeof(m->shm_name)-1);
+  m->shm->seq=0;
+  m->shm->magic=TRIG_MON_SHM_MAGIC;
+  return(0);
+}
+
+void trig_mon_publish(struct trig_mon *m)
+{
+  struct trig_mon_shm *s=m->shm;
+  int i,n;
+
+  if(s==NULL || m->n==0)
+    return;
+  n=(m->n-1<m->window) ? m->n-1 : m->window;
+  s->seq++; /* odd: being written */
+  __sync_synchronize();
+  s->period_ms=m->period_ms;
+  s->window=n;
+  s->t_ns=m->ring[(m->head+TRIG_MON_NSAMPLES-1)%TRIG_MON_NSAMPLES].t_ns;
+  s->nsamples=m->nsamples;
+  for(i=0;i<TRIG_MON_NCTR;i++){
+    s->count[i]=m->count[i];
+    if(trig_mon_rate(m,i,1,&s->rate[i])!=0)
+      s->rate[i]=0;
+    if(trig_mon_rate(m,i,n,&s->rate_avg[i])!=0)
+      s->rate_avg[i]=0;
+  }
+  __sync_synchronize();
+  s->seq++;
+}
+
+void trig_mon_end(struct trig_mon *m)
+{
+  if(m->shm!=NULL){
+    munmap(m->shm,sizeof(struct trig_mon_shm));
+    shm_unlink(m->shm_name);
+  }
+  m->shm=NULL;
+}
+
+int trig_mon_shm_read(const char *name,struct trig_mon_shm *s)
+{
+  const struct trig_mon_shm *p;
+  uint32_t seq;
+  int fd,n;
+
+  if(name==NULL)
+    name=TRIG_MON_SHM;
+  fd=shm_open(name,O_RDONLY,0);
+  if(fd<0)
+    return(1);
+  p=mmap(NULL,sizeof(*p),PROT_READ,MAP_SHARED,fd,0);
+  close(fd);
+  if(p==MAP_FAILED)
+    return(1);
+  for(n=0;n<TRIG_MON_READ_TRIES;n++){
+    seq=p->seq;
+    __sync_synchronize();
+    memcpy(s,(const void *)p,sizeof(*s));
+    __sync_synchronize();
+    if(!(seq & 1) && seq==p->seq)
+      break;
+    usleep(100);
+  }
+  munmap((void *)p,sizeof(*p));
+  return(n==TRIG_MON_READ_TRIES || s->magic!=TRIG_MON_SHM_MAGIC);
+}
+
+void trig_mon_shm_print(FILE *fp,const struct trig_mon_shm *s,int json)
+{
+  int i;
+
+  if(json){
+    fprintf(fp,"{\"period_ms\":%u,\"window\":%u,\"nsamples\":%llu",
+	    s->period_ms,s->window,(unsigned long long)s->nsamples);
+    for(i=0;i<TRIG_MON_NCTR;i++)
+      fprintf(fp,",\"%s\":{\"count\":%llu,\"rate\":%.3f,\"rate_avg\":%.3f}",
+	      ctr_name[i],(unsigned long long)s->count[i],s->rate[i],
+	      s->rate_avg[i]);
+    fprintf(fp,"}\n");
+    return;
+  }
+  fprintf(fp,"trigger rates (%u ms period, average over %u):\n",
+	  s->period_ms,s->window);
+  for(i=0;i<TRIG_MON_NCTR;i++)
+    fprintf(fp,"  %-13s %12llu %10.3f Hz %10.3f Hz\n",ctr_name[i],
+	    (unsigned long long)s->count[i],s->rate[i],s->rate_avg[i]);
+}
+
+#ifdef TRIG_MON_MAIN
+static volatile sig_atomic_t mon_stop=0;
+
+static void mon_signal(int sig)
+{
+  mon_stop=1;
+}
+
+int main(int argc,char *argv[])
+{
+  static struct trig_mon mon;
+  struct trig_mon_shm s;
+  struct rd_dev dev;
+  struct timespec next,now;
+  const char *name=NULL,*path=NULL;
+  uint32_t period_ms=TRIG_MON_PERIOD_MS;
+  int c,window=TRIG_MON_WINDOW,nsamples=0,verbose=0,rd=0,json=0;
+
+  while((c=getopt(argc,argv,"p:w:s:D:n:vrj"))!=-1){
+    switch(c){
+    case 'p':
+      period_ms=atoi(optarg);
+      break;
+    case 'w':
+      window=atoi(optarg);
+      break;
+    case 's':
+      name=optarg;
+      break;
+    case 'D':
+      path=optarg;
+      break;
+    case 'n':
+      nsamples=atoi(optarg);
+      break;
+    case 'v':
+      verbose=1;
+      break;
+    case 'r':
+      rd=1;
+      break;
+    case 'j':
+      json=1;
+      break;
+    default:
+      printf("usage: %s [-p period ms] [-w window] [-s shm] [-D path] "
+	     "[-n samples] [-v]\n"
+	     "       %s -r [-j] [-s shm]\n",argv[0],argv[0]);
+      return(1);
+    }
+  }
+  if(rd){
+    if(trig_mon_shm_read(name,&s)!=0){
+      printf("trig_mon: no rates published\n");
+      return(1);
+    }
+    trig_mon_shm_print(stdout,&s,json);
+    return(0);
+  }
+  if(period_ms<1)
+    period_ms=1;
+
+  rd_dev_init(&dev);
+  if(rd_dev_open(&dev,path,RD_DEV_MASK(RD_DEV_REGS) |
+		 RD_DEV_MASK(RD_DEV_TTAG))!=0)
+    return(1);
+  if(trig_mon_init(&mon,&dev,period_ms,window)!=0 ||
+     trig_mon_publish_open(&mon,name)!=0)
+    return(1);
+  signal(SIGINT,mon_signal);
+  signal(SIGTERM,mon_signal);
+
+  /* absolute wakeups: the period does not drift with the work done */
+  clock_gettime(CLOCK_MONOTONIC,&next);
+  trig_mon_sample(&mon,next.tv_sec*1000000000ULL+next.tv_nsec);
+  while(!mon_stop && (nsamples<=0 || mon.nsamples<=(uint64_t)nsamples)){
+    next.tv_nsec+=(period_ms%1000)*1000000L;
+    next.tv_sec+=period_ms/1000+next.tv_nsec/1000000000L;
+    next.tv_nsec%=1000000000L;
+    clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&next,NULL);
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    trig_mon_sample(&mon,now.tv_sec*1000000000ULL+now.tv_nsec);
+    trig_mon_publish(&mon);
+    if(verbose){
+      memcpy(&s,mon.shm,sizeof(s));
+      trig_mon_shm_print(stdout,&s,json);
+    }
+  }
+  trig_mon_end(&mon);
+  rd_dev_close(&dev);
+  return(0);
+}
+#endif
@@ -0,0 +1,98 @@
+/* Trigger rate monitor: samples the SDE trigger counters (compatibility
+   trigger and delayed rates, scalers A/B/C) and the dead time counter
+   of the time tagging at a fixed period, from a device context mapped
+   once (rd_dev.h).
+
+   The counters are free running and wrap at TRIG_MON_WIDTH bits; the
+   monitor keeps them unwrapped (64 bits), so a counter is only lost if
+   it turns around more than once between two samples. The samples are
+   kept in a ring of TRIG_MON_NSAMPLES and the rates (last period and
+   average over the window) published in a shared memory segment, so
+   the acquisition and the web page read them without mapping the
+   registers themselves (trig_mon_shm_read).
+*/
+
+#ifndef _TRIG_MON_H
+#define _TRIG_MON_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "rd_dev.h"
+
+enum{
+  TRIG_MON_RATES=0,  /* COMPATIBILITY_TRIG_RATES */
+  TRIG_MON_DELAYED,  /* COMPATIBILITY_DELAYED_RATES */
+  TRIG_MON_SCALER_A,
+  TRIG_MON_SCALER_B,
+  TRIG_MON_SCALER_C,
+  TRIG_MON_DEAD,     /* TTAG_DEAD_CTR */
+  TRIG_MON_NCTR
+};
+
+#define TRIG_MON_WIDTH 32
+#define TRIG_MON_NSAMPLES 1024
+#define TRIG_MON_PERIOD_MS 1000
+#define TRIG_MON_WINDOW 60         /* samples in the average */
+#define TRIG_MON_SHM "/uub_trig_mon"
+#define TRIG_MON_SHM_MAGIC 0x54524d31 /* "TRM1" */
+
+struct trig_mon_sample
+{
+  uint64_t t_ns;                /* CLOCK_MONOTONIC */
+  uint64_t count[TRIG_MON_NCTR]; /* unwrapped */
+};
+
+/* the published segment; seq is odd while it is written */
+struct trig_mon_shm
+{
+  uint32_t magic;
+  volatile uint32_t seq;
+  uint32_t period_ms;
+  uint32_t window;        /* samples in rate_avg */
+  uint64_t t_ns;          /* last sample */
+  uint64_t nsamples;      /* samples taken since the start */
+  uint64_t count[TRIG_MON_NCTR];
+  double rate[TRIG_MON_NCTR];     /* Hz, last period */
+  double rate_avg[TRIG_MON_NCTR]; /* Hz, over the window */
+};
+
+struct trig_mon
+{
+  uint32_t volatile *regs;
+  uint32_t volatile *ttag;
+  uint32_t last[TRIG_MON_NCTR];
+  uint64_t count[TRIG_MON_NCTR];
+  uint64_t nsamples;
+  uint32_t period_ms;
+  int window;
+
+  struct trig_mon_sample ring[TRIG_MON_NSAMPLES];
+  int head; /* next sample */
+  int n;
+
+  struct trig_mon_shm *shm;
+  char shm_name[64];
+};
+
+const char *trig_mon_name(int ctr);
+
+/* the context must map RD_DEV_REGS and RD_DEV_TTAG */
+int trig_mon_init(struct trig_mon *m,const struct rd_dev *d,
+		  uint32_t period_ms,int window);
+void trig_mon_sample(struct trig_mon *m,uint64_t t_ns);
+
+/* rate over the last n periods (n<m->n); 1 if there are not enough
+   samples */
+int trig_mon_rate(const struct trig_mon *m,int ctr,int n,double *rate);
+
+/* name NULL: TRIG_MON_SHM */
+int trig_mon_publish_open(struct trig_mon *m,const char *name);
+void trig_mon_publish(struct trig_mon *m);
+void trig_mon_end(struct trig_mon *m);
+
+/* consistent copy of the published rates, for the readers */
+int trig_mon_shm_read(const char *name,struct trig_mon_shm *s);
+void trig_mon_shm_print(FILE *fp,const struct trig_mon_shm *s,int json);
+
+#endif /*_TRIG_MON_H*/
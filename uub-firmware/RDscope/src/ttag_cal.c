@@ -0,0 +1,67 @@
+#include <string.h>
+
+#include "time_tagging_defs.h"
+#include "ttag_cal.h"
+
+#define NS_PER_S 1000000000ULL
+#define CAL_TOL ((uint32_t)((uint64_t)TTAG_CAL_CLOCK_HZ*TTAG_CAL_TOL_PPM/1000000))
+
+void ttag_cal_init(struct ttag_cal *c)
+{
+  memset(c,0,sizeof(*c));
+  c->scale=(NS_PER_S<<32)/TTAG_CAL_CLOCK_HZ;
+}
+
+int ttag_cal_ns(struct ttag_cal *c,uint32_t second,uint32_t tics,
+		uint32_t pps_tics,uint32_t pps_cal,uint32_t *nanosec)
+{
+  uint64_t ns;
+  int late=0;
+
+  /* a new second (or a new measure of it): one division */
+  if(c->nevts==0 || second!=c->second || pps_cal!=c->pps_cal){
+    c->second=second;
+    c->pps_cal=pps_cal;
+    c->ok=(pps_cal>=TTAG_CAL_CLOCK_HZ-CAL_TOL &&
+	   pps_cal<=TTAG_CAL_CLOCK_HZ+CAL_TOL);
+    if(c->ok)
+      c->scale=(NS_PER_S<<32)/pps_cal;
+    else
+      c->nbad_cal++; /* the last good scale is kept */
+    c->nseconds++;
+  }
+  c->nevts++;
+  ns=(((tics-pps_tics) & TTAG_TICS_MASK)*c->scale+(1ULL<<31))>>32;
+  if(ns>=NS_PER_S){
+    c->nlate++;
+    ns=NS_PER_S-1;
+    late=1;
+  }
+  *nanosec=ns;
+  return(!c->ok || late);
+}
+
+uint32_t ttag_cal_read(struct ttag_cal *c,const uint32_t volatile *ttag,
+		       struct shwr_gps_info *g)
+{
+  uint32_t sec;
+
+  sec=ttag[TTAG_SHWR_SECONDS_ADDR];
+  g->second=sec & TTAG_SECONDS_MASK;
+  g->ticks=ttag[TTAG_SHWR_TICS_ADDR] & TTAG_TICS_MASK;
+  if(ttag_cal_ns(c,g->second,g->ticks,
+		 ttag[TTAG_SHWR_PPS_TICS_ADDR] & TTAG_TICS_MASK,
+		 ttag[TTAG_SHWR_PPS_CAL_ADDR] & TTAG_TICS_MASK,&g->nanosec)==0)
+    g->pps_cal=c->pps_cal;
+  else
+    g->pps_cal=0;
+  return(sec);
+}
+
+void ttag_cal_print(FILE *fp,const struct ttag_cal *c)
+{
+  fprintf(fp,"time tags: %u events in %u seconds, %u with a bad PPS "
+	  "calibration, %u events late (%.0f ticks/s)\n",c->nevts,
+	  c->nseconds,c->nbad_cal,c->nlate,
+	  (double)(NS_PER_S<<32)/c->scale);
+}
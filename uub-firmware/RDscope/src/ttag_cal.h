@@ -0,0 +1,57 @@
+/* Calibrated event time from the time tagging registers
+   (time_tagging_defs.h).
+
+   The time tagging counts the ticks of the ~120 MHz clock in a free
+   running counter of TTAG_TICS_MASK (27 bits). With a shower trigger
+   the FPGA latches the counter (TTAG_SHWR_TICS), the counter at the
+   last PPS (TTAG_SHWR_PPS_TICS) and the ticks measured between the two
+   last PPS (TTAG_SHWR_PPS_CAL). The event is then at
+       (TTAG_SHWR_TICS-TTAG_SHWR_PPS_TICS)*1e9/TTAG_SHWR_PPS_CAL
+   ns after the GPS second of TTAG_SHWR_SECONDS.
+
+   The scale (ns per tick) only changes once a second, so it is kept
+   for the current second: the conversion of an event is a multiply
+   and a shift. A PPS_CAL out of TTAG_CAL_TOL_PPM of the nominal clock
+   (missing PPS, counter not started) is not used: the last good scale
+   is kept, or the nominal one.
+*/
+
+#ifndef _TTAG_CAL_H
+#define _TTAG_CAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "shwr_evt_defs.h"
+
+#define TTAG_CAL_CLOCK_HZ 120000000
+#define TTAG_CAL_TOL_PPM 200
+
+struct ttag_cal
+{
+  uint32_t second;    /* of the cached scale */
+  uint32_t pps_cal;   /* PPS_CAL seen in that second */
+  int ok;             /* ... and within the tolerance */
+  uint64_t scale;     /* ns per tick, 32.32 fixed point */
+
+  uint32_t nevts;     /* events converted */
+  uint32_t nseconds;  /* seconds calibrated */
+  uint32_t nbad_cal;  /* seconds with a PPS_CAL out of tolerance */
+  uint32_t nlate;     /* events more than a second after their PPS */
+};
+
+void ttag_cal_init(struct ttag_cal *c);
+
+/* ns after the GPS second of an event from the raw latched values;
+   1 if the time is not reliable (bad PPS_CAL, or late) */
+int ttag_cal_ns(struct ttag_cal *c,uint32_t second,uint32_t tics,
+		uint32_t pps_tics,uint32_t pps_cal,uint32_t *nanosec);
+
+/* read the shower time tag from the registers into g (second, raw
+   ticks, calibrated nanosec and the PPS_CAL used, 0 if not reliable);
+   return the seconds register, with the event counter */
+uint32_t ttag_cal_read(struct ttag_cal *c,const uint32_t volatile *ttag,
+		       struct shwr_gps_info *g);
+
+void ttag_cal_print(FILE *fp,const struct ttag_cal *c);
+
+#endif /*_TTAG_CAL_H*/
@@ -0,0 +1,463 @@
+// Software model of the shower buffers, time tagging and RD interface
+// (uub_emu.h).
+//
+//   uub_emu [-D dir] [-r rate] [-d rd delay us] [-l rd loss]
+//           [-p parity error fraction] [-k clock ppm] [-t seconds]
+//
+// runs the model on its own (built with UUB_EMU_MAIN) over the stand-in
+// files in dir (default UUB_EMU_DIR), for rd -D dir to read them.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+#include "time_tagging_defs.h"
+#include "rd_interface_defs.h"
+#include "shwr_evt_defs.h"
+#include "uub_emu.h"
+
+#define UUB_EMU_DIR "/dev/shm/uub_emu"
+#define UUB_EMU_SECOND0 1000000000 /* GPS second at the start */
+
+#define EMU_BASELINE 250
+#define EMU_RD_BASELINE 2048
+
+uint64_t uub_emu_now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return((uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec);
+}
+
+static uint32_t emu_rand(struct uub_emu *e)
+{
+  /* xorshift32 */
+  e->rng^=e->rng<<13;
+  e->rng^=e->rng>>17;
+  e->rng^=e->rng<<5;
+  return(e->rng);
+}
+
+static double emu_uniform(struct uub_emu *e)
+{
+  return((emu_rand(e)>>8)*(1./16777216.)); /* [0,1) */
+}
+
+/* the free running tick counter, not masked, at dt ns from the start */
+static uint64_t emu_tics(const struct uub_emu *e,uint64_t dt)
+{
+  return((uint64_t)(dt*1e-9*UUB_EMU_CLOCK_HZ*(1.+e->cfg.clock_ppm*1e-6)));
+}
+
+static uint64_t emu_interval(struct uub_emu *e)
+{
+  if(e->cfg.rate<=0)
+    return(UINT64_MAX/2);
+  return((uint64_t)(-log(1.-emu_uniform(e))/e->cfg.rate*1e9));
+}
+
+void uub_emu_config_default(struct uub_emu_config *c)
+{
+  memset(c,0,sizeof(*c));
+  c->rate=UUB_EMU_RATE;
+  c->rd_delay_us=UUB_EMU_RD_DELAY_US;
+  c->clock_ppm=UUB_EMU_CLOCK_PPM;
+  c->trig_id=COMPATIBILITY_SHWR_BUF_TRIG_SB;
+  c->seed=1;
+}
+
+/* the registers seen by the readout, from the model state */
+static void emu_publish(struct uub_emu *e,uint64_t now)
+{
+  uint32_t volatile *regs=e->dev->ptr[RD_DEV_REGS];
+  uint32_t volatile *ttag=e->dev->ptr[RD_DEV_TTAG];
+  uint32_t volatile *rd=e->dev->ptr[RD_DEV_RD_REGS];
+  uint32_t nfull=__builtin_popcount(e->shwr_full);
+  struct uub_emu_meta *m=&e->meta[e->shwr_rnum];
+  uint64_t t=now-e->t0;
+
+  if(nfull>0){
+    regs[SHWR_BUF_START_ADDR]=m->trace_start;
+    regs[SHWR_BUF_TRIG_ID_ADDR]=e->cfg.trig_id;
+    ttag[TTAG_SHWR_SECONDS_ADDR]=m->seconds;
+    ttag[TTAG_SHWR_TICS_ADDR]=m->tics;
+    ttag[TTAG_SHWR_PPS_TICS_ADDR]=m->pps_tics;
+    ttag[TTAG_SHWR_PPS_CAL_ADDR]=m->pps_cal;
+  }
+  ttag[TTAG_PPS_SECONDS_ADDR]=(UUB_EMU_SECOND0+t/1000000000) &
+    TTAG_SECONDS_MASK;
+  ttag[TTAG_PPS_TICS_ADDR]=emu_tics(e,t/1000000000*1000000000) &
+    TTAG_TICS_MASK;
+  ttag[TTAG_DEAD_CTR_ADDR]=e->dead_ctr;
+  rd[RD_IFC_STATUS_ADDR]=(e->rd_rnum<<RD_BUF_RNUM_SHIFT) |
+    (e->rd_wnum<<RD_BUF_WNUM_SHIFT) |
+    ((e->rd_busy>=0 ? 1U<<e->rd_busy : 0)<<RD_BUF_BUSY_SHIFT) |
+    (e->rd_full<<RD_BUF_FULL_SHIFT) |
+    (e->rd_parity0<<RD_PARITY0_SHIFT) |
+    (e->rd_parity1<<RD_PARITY1_SHIFT);
+  /* the event registers first, the buffer status last */
+  __sync_synchronize();
+  regs[SHWR_BUF_STATUS_ADDR]=(e->shwr_rnum<<SHWR_BUF_RNUM_SHIFT) |
+    (e->shwr_wnum<<SHWR_BUF_WNUM_SHIFT) |
+    (e->shwr_full<<SHWR_BUF_FULL_SHIFT) |
+    (nfull<<SHWR_BUF_NFULL_SHIFT);
+}
+
+/* a value written in a control register gives back that buffer and the
+   older ones; return the number of buffers given back */
+static int emu_control(uint32_t v,int *rnum,uint32_t *full,int nbuf)
+{
+  int buf,n=0;
+
+  if(v==UUB_EMU_IDLE)
+    return(0);
+  buf=v & (nbuf-1);
+  if(!((*full>>buf) & 1))
+    return(0);
+  do {
+    *full&=~(1U<<*rnum);
+    *rnum=(*rnum+1)%nbuf;
+    n++;
+  } while((*rnum+nbuf-1)%nbuf!=buf);
+  return(n);
+}
+
+/* apply the control registers and publish the new status; only then
+   are they set back to UUB_EMU_IDLE, which a reader in another process
+   waits for (uub_emu_attach). Return the shower buffers given back. */
+static int emu_release(struct uub_emu *e,uint64_t now)
+{
+  uint32_t volatile *shwr_ctl=&e->dev->ptr[RD_DEV_REGS][SHWR_BUF_CONTROL_ADDR];
+  uint32_t volatile *rd_ctl=&e->dev->ptr[RD_DEV_RD_REGS][RD_IFC_CONTROL_ADDR];
+  uint32_t shwr_v=*shwr_ctl,rd_v=*rd_ctl;
+  int n;
+
+  if(shwr_v==UUB_EMU_IDLE && rd_v==UUB_EMU_IDLE)
+    return(0);
+  n=emu_control(shwr_v,&e->shwr_rnum,&e->shwr_full,SHWR_MEM_NBUF);
+  e->stats.nshwr_release+=n;
+  e->stats.nrd_release+=emu_control(rd_v,&e->rd_rnum,&e->rd_full,
+				    RD_MEM_NBUF);
+  emu_publish(e,now);
+  __sync_synchronize();
+  /* a new value written meanwhile is seen at the next step */
+  if(shwr_v!=UUB_EMU_IDLE)
+    __sync_val_compare_and_swap((uint32_t *)shwr_ctl,shwr_v,UUB_EMU_IDLE);
+  if(rd_v!=UUB_EMU_IDLE)
+    __sync_val_compare_and_swap((uint32_t *)rd_ctl,rd_v,UUB_EMU_IDLE);
+  return(n);
+}
+
+/* rd_dev_write of the reader in the same process: the buffer is given
+   back before the write returns, as with the FPGA */
+static void emu_write_hook(void *arg,int r,int addr)
+{
+  struct uub_emu *e=arg;
+
+  pthread_mutex_lock(&e->lock);
+  emu_release(e,uub_emu_now());
+  pthread_mutex_unlock(&e->lock);
+}
+
+/* rd_dev_write of a reader sharing the files with a uub_emu process:
+   wait the model to take the value */
+static void emu_remote_hook(void *arg,int r,int addr)
+{
+  struct rd_dev *d=arg;
+  uint64_t t0=uub_emu_now();
+
+  while(d->ptr[r][addr]!=UUB_EMU_IDLE){
+    if(uub_emu_now()-t0>UUB_EMU_ATTACH_WAIT_NS){
+      printf("uub_emu: no model running on %s, writes are not waited for "
+	     "any more\n",d->path);
+      d->write_hook=NULL;
+      return;
+    }
+    sched_yield();
+  }
+}
+
+void uub_emu_attach(struct rd_dev *d)
+{
+  d->write_hook=emu_remote_hook;
+  d->hook_arg=d;
+}
+
+static void emu_shwr_fill(struct uub_emu *e,int buf,uint32_t start)
+{
+  uint32_t volatile *mem;
+  int i,j,k,amp[2],s[2];
+
+  for(i=0;i<SHWR_RAW_NCH_MAX;i++){
+    mem=e->dev->ptr[RD_DEV_SHWR0+i]+buf*SHWR_NSAMPLES;
+    amp[0]=emu_rand(e)%2000;
+    amp[1]=amp[0]/32; /* low gain */
+    for(j=0;j<SHWR_NSAMPLES;j++){
+      for(k=0;k<2;k++){
+	s[k]=EMU_BASELINE+(emu_rand(e)&3);
+	if(j>=SHWR_NSAMPLES/3 && j<SHWR_NSAMPLES/3+64)
+	  s[k]+=amp[k]*exp(-(j-SHWR_NSAMPLES/3)/8.);
+	if(s[k]>0xfff)
+	  s[k]=0xfff;
+      }
+      mem[(j+start)%SHWR_NSAMPLES]=s[0] | (s[1]<<16);
+    }
+  }
+}
+
+/* 12 bits sample and its odd parity bit, as in the RD words */
+static uint32_t emu_rd_sample(uint32_t v)
+{
+  return((v<<1) | !(__builtin_popcount(v) & 1));
+}
+
+static void emu_rd_fill(struct uub_emu *e,int buf)
+{
+  uint32_t volatile *mem=e->dev->ptr[RD_DEV_RD_MEM]+buf*RD_MEM_WORDS;
+  uint32_t w,bad0=0,bad1=0;
+  int i;
+
+  for(i=0;i<RD_MEM_WORDS;i++){
+    w=emu_rd_sample((EMU_RD_BASELINE+(emu_rand(e)&0x3f)-32) & 0xfff) |
+      (emu_rd_sample((EMU_RD_BASELINE+(emu_rand(e)&0x3f)-32) & 0xfff)<<16);
+    if(e->cfg.parity>0 && emu_uniform(e)<e->cfg.parity){
+      if(emu_rand(e) & 1){
+	w^=1;
+	bad0=1;
+      } else {
+	w^=1<<16;
+	bad1=1;
+      }
+      e->stats.nrd_parity++;
+    }
+    mem[i]=w;
+  }
+  e->rd_parity0=(e->rd_parity0 & ~(1U<<buf)) | (bad0<<buf);
+  e->rd_parity1=(e->rd_parity1 & ~(1U<<buf)) | (bad1<<buf);
+}
+
+static void emu_trigger(struct uub_emu *e,uint64_t t)
+{
+  struct uub_emu_meta *m;
+  uint64_t dt=t-e->t0,sec,pps;
+  int buf;
+
+  e->stats.ntrig++;
+  if(e->shwr_full==SHWR_BUF_FULL_MASK){
+    e->stats.ndead++;
+    e->dead_ctr++;
+    return;
+  }
+  buf=e->shwr_wnum;
+  m=&e->meta[buf];
+  m->trace_start=emu_rand(e)%SHWR_NSAMPLES;
+  m->seconds=((UUB_EMU_SECOND0+dt/1000000000) & TTAG_SECONDS_MASK) |
+    ((e->evtctr & TTAG_EVTCTR_MASK)<<TTAG_EVTCTR_SHIFT);
+  sec=dt/1000000000;
+  pps=emu_tics(e,sec*1000000000);
+  m->tics=emu_tics(e,dt) & TTAG_TICS_MASK;
+  m->pps_tics=pps & TTAG_TICS_MASK;
+  m->pps_cal=(sec>0) ? pps-emu_tics(e,(sec-1)*1000000000) :
+    emu_tics(e,1000000000);
+  emu_shwr_fill(e,buf,m->trace_start);
+  e->evtctr++;
+
+  /* the RD transfer starts with the trigger */
+  if(e->cfg.rd_loss>0 && emu_uniform(e)<e->cfg.rd_loss){
+    e->stats.nrd_lost++;
+  } else if(e->rd_busy>=0){
+    e->stats.nrd_busy++;
+  } else if((e->rd_full>>e->rd_wnum) & 1){
+    e->stats.nrd_full++;
+  } else {
+    e->rd_busy=e->rd_wnum;
+    e->rd_done=t+(uint64_t)(e->cfg.rd_delay_us*1000);
+  }
+
+  __sync_synchronize();
+  e->shwr_full|=1U<<buf;
+  e->shwr_wnum=(buf+1)%SHWR_MEM_NBUF;
+  e->stats.nstored++;
+}
+
+void uub_emu_step(struct uub_emu *e,uint64_t now)
+{
+  int notify;
+
+  pthread_mutex_lock(&e->lock);
+  /* a buffer given back may let the readout see the next one */
+  notify=emu_release(e,now);
+
+  /* RD transfer ends and triggers, in time order */
+  while(1){
+    if(e->rd_busy>=0 && e->rd_done<=now && e->rd_done<=e->t_next){
+      emu_rd_fill(e,e->rd_busy);
+      __sync_synchronize();
+      e->rd_full|=1U<<e->rd_busy;
+      e->rd_wnum=(e->rd_busy+1)%RD_MEM_NBUF;
+      e->rd_busy=-1;
+      e->stats.nrd++;
+    } else if(e->t_next<=now){
+      emu_trigger(e,e->t_next);
+      e->t_next+=emu_interval(e);
+      notify=1;
+    } else {
+      break;
+    }
+  }
+  emu_publish(e,now);
+  pthread_mutex_unlock(&e->lock);
+  if(notify && e->cfg.notify!=NULL)
+    e->cfg.notify(e->cfg.notify_arg);
+}
+
+int uub_emu_init(struct uub_emu *e,struct rd_dev *d,
+		 const struct uub_emu_config *c)
+{
+  int r;
+
+  for(r=0;r<RD_DEV_NREGIONS;r++){
+    if(d->ptr[r]==NULL){
+      printf("uub_emu: %s is not mapped\n",rd_dev_region_name(r));
+      return(1);
+    }
+  }
+  memset(e,0,sizeof(*e));
+  e->dev=d;
+  if(c!=NULL)
+    e->cfg=*c;
+  else
+    uub_emu_config_default(&e->cfg);
+  e->rng=e->cfg.seed ? e->cfg.seed : 1;
+  e->rd_busy=-1;
+  pthread_mutex_init(&e->lock,NULL);
+  e->t0=uub_emu_now();
+  e->t_next=e->t0+emu_interval(e);
+
+  d->ptr[RD_DEV_REGS][SHWR_BUF_CONTROL_ADDR]=UUB_EMU_IDLE;
+  d->ptr[RD_DEV_RD_REGS][RD_IFC_CONTROL_ADDR]=UUB_EMU_IDLE;
+  d->write_hook=emu_write_hook;
+  d->hook_arg=e;
+  emu_publish(e,e->t0);
+  return(0);
+}
+
+static void *emu_thread(void *arg)
+{
+  struct uub_emu *e=arg;
+  struct timespec ts={0,UUB_EMU_POLL_NS};
+
+  while(!e->stop){
+    uub_emu_step(e,uub_emu_now());
+    nanosleep(&ts,NULL);
+  }
+  return(NULL);
+}
+
+int uub_emu_start(struct uub_emu *e)
+{
+  e->stop=0;
+  if(pthread_create(&e->thread,NULL,emu_thread,e)!=0){
+    printf("uub_emu: not possible to start the thread\n");
+    return(1);
+  }
+  e->running=1;
+  return(0);
+}
+
+void uub_emu_stop(struct uub_emu *e)
+{
+  if(!e->running)
+    return;
+  e->stop=1;
+  pthread_join(e->thread,NULL);
+  e->running=0;
+}
+
+void uub_emu_print(FILE *fp,const struct uub_emu *e)
+{
+  const struct uub_emu_stats *s=&e->stats;
+
+  fprintf(fp,"emulator: %u triggers, %u stored, %u dead (%.2f%%)\n",
+	  s->ntrig,s->nstored,s->ndead,
+	  s->ntrig ? 100.*s->ndead/s->ntrig : 0.);
+  fprintf(fp,"emulator: RD %u transferred, %u not sent, %u lost (transfer "
+	  "busy), %u lost (buffers full), %u bad parity words\n",s->nrd,
+	  s->nrd_lost,s->nrd_busy,s->nrd_full,s->nrd_parity);
+  fprintf(fp,"emulator: released %u shower and %u RD buffers\n",
+	  s->nshwr_release,s->nrd_release);
+}
+
+#ifdef UUB_EMU_MAIN
+static volatile int emu_stop=0;
+
+static void emu_signal(int sig)
+{
+  emu_stop=1;
+}
+
+int main(int argc,char *argv[])
+{
+  struct uub_emu_config cfg;
+  struct uub_emu emu;
+  struct rd_dev dev;
+  struct timespec ts={0,UUB_EMU_POLL_NS};
+  const char *dir=UUB_EMU_DIR;
+  double seconds=0;
+  uint64_t t_end;
+  int c;
+
+  uub_emu_config_default(&cfg);
+  while((c=getopt(argc,argv,"D:r:d:l:p:k:t:"))!=-1){
+    switch(c){
+    case 'D':
+      dir=optarg;
+      break;
+    case 'r':
+      cfg.rate=atof(optarg);
+      break;
+    case 'd':
+      cfg.rd_delay_us=atof(optarg);
+      break;
+    case 'l':
+      cfg.rd_loss=atof(optarg);
+      break;
+    case 'p':
+      cfg.parity=atof(optarg);
+      break;
+    case 'k':
+      cfg.clock_ppm=atof(optarg);
+      break;
+    case 't':
+      seconds=atof(optarg);
+      break;
+    default:
+      printf("usage: %s [-D dir] [-r rate] [-d rd delay us] [-l rd loss]\n"
+	     "       [-p parity error fraction] [-k clock ppm] [-t seconds]\n",
+	     argv[0]);
+      return(1);
+    }
+  }
+  mkdir(dir,0755);
+  rd_dev_init(&dev);
+  if(rd_dev_open(&dev,dir,RD_DEV_ALL)!=0)
+    return(1);
+  if(uub_emu_init(&emu,&dev,&cfg)!=0)
+    return(1);
+  signal(SIGINT,emu_signal);
+  signal(SIGTERM,emu_signal);
+  t_end=emu.t0+(uint64_t)(seconds*1e9);
+  while(!emu_stop && (seconds<=0 || uub_emu_now()<t_end)){
+    uub_emu_step(&emu,uub_emu_now());
+    nanosleep(&ts,NULL);
+  }
+  uub_emu_print(stdout,&emu);
+  rd_dev_close(&dev);
+  return(0);
+}
+#endif
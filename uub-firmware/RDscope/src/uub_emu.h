@@ -0,0 +1,134 @@
+/* Software model of the SDE trigger shower buffers, the time tagging
+   and the RD interface, over the stand-in files of a device context
+   (rd_dev.h), to run and benchmark the readout out of the UUB.
+
+   Triggers come at random (Poisson) times with the given mean rate.
+   Each one fills the next free shower buffer with synthetic traces
+   and its time tag (ticks of a clock off by clock_ppm, with the PPS
+   calibration, as in ttag_cal.h), or is counted as dead time (TTAG_DEAD_CTR) when
+   the 4 buffers are full. The RD interface then transfers the RD
+   event: the buffer is busy for rd_delay_us and then full, with odd
+   parity on each 12 bits sample and a fraction of bad words flagged
+   in RD_PARITY0/1. A fraction of the triggers may have no RD event.
+
+   The control registers (SHWR_BUF_CONTROL, RD_IFC_CONTROL) are kept
+   at UUB_EMU_IDLE by the model: a value written there by the readout
+   gives back that buffer and the older full ones, in the order they
+   were filled, as the FPGA does. A write with rd_dev_write has taken
+   effect (status published) when it returns: at once in the process
+   of the model, or waiting the model process (uub_emu_attach). The
+   registers which describe the event (SHWR_BUF_START, SHWR_BUF_TRIG_ID, TTAG_SHWR_*) always show
+   the oldest full buffer.
+
+   The model runs either in a thread of the reader (uub_emu_start) or
+   in a process on its own sharing the files (uub_emu main, built with
+   UUB_EMU_MAIN), e.g. in /dev/shm.
+*/
+
+#ifndef _UUB_EMU_H
+#define _UUB_EMU_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "xparameters.h"
+#include "sde_trigger_defs.h"
+#include "rd_dev.h"
+
+#define UUB_EMU_IDLE 0xffffffff
+#define UUB_EMU_POLL_NS 10000 /* thread/process step period */
+#define UUB_EMU_ATTACH_WAIT_NS 100000000 /* no model process after it */
+
+struct uub_emu_config
+{
+  double rate;         /* mean trigger rate (Hz) */
+  double rd_delay_us;  /* RD transfer time after the trigger */
+  double rd_loss;      /* fraction of triggers without RD event */
+  double parity;       /* fraction of RD words with a parity error */
+  double clock_ppm;    /* error of the time tagging clock */
+  uint32_t trig_id;    /* SHWR_BUF_TRIG_ID of the events */
+  uint32_t seed;
+  /* called at each stored trigger, e.g. evt_wait_notify; may be NULL */
+  void (*notify)(void *arg);
+  void *notify_arg;
+};
+
+#define UUB_EMU_RATE 100.
+#define UUB_EMU_RD_DELAY_US 200.
+#define UUB_EMU_CLOCK_HZ 120000000.
+#define UUB_EMU_CLOCK_PPM 20.
+
+struct uub_emu_stats
+{
+  uint32_t ntrig;      /* triggers */
+  uint32_t nstored;    /* ... stored in a shower buffer */
+  uint32_t ndead;      /* ... lost, all the shower buffers full */
+  uint32_t nrd;        /* RD events transferred */
+  uint32_t nrd_lost;   /* triggers without RD event (rd_loss) */
+  uint32_t nrd_busy;   /* ... lost, the previous RD transfer going on */
+  uint32_t nrd_full;   /* ... lost, the RD buffer to write is full */
+  uint32_t nrd_parity; /* RD words written with bad parity */
+  uint32_t nshwr_release;
+  uint32_t nrd_release;
+};
+
+struct uub_emu_meta
+{
+  uint32_t trace_start;
+  uint32_t seconds;    /* with the event counter */
+  uint32_t tics;
+  uint32_t pps_tics;   /* at the PPS of the second */
+  uint32_t pps_cal;    /* ticks of the previous second */
+};
+
+struct uub_emu
+{
+  struct rd_dev *dev;
+  struct uub_emu_config cfg;
+  struct uub_emu_stats stats;
+
+  uint64_t t0;         /* model start, ns */
+  uint64_t t_next;     /* next trigger */
+  uint32_t rng;
+  uint32_t evtctr;
+  uint32_t dead_ctr;
+
+  int shwr_rnum,shwr_wnum;
+  uint32_t shwr_full;
+  struct uub_emu_meta meta[SHWR_MEM_NBUF];
+
+  int rd_rnum,rd_wnum;
+  uint32_t rd_full;
+  uint32_t rd_parity0,rd_parity1;
+  int rd_busy;         /* RD buffer being transferred, -1 none */
+  uint64_t rd_done;    /* ... until */
+
+  pthread_mutex_t lock; /* the model state: thread and rd_dev_write */
+  pthread_t thread;
+  volatile int stop;
+  int running;
+};
+
+/* the device context must map all the regions, usually stand-in files;
+   c NULL: default configuration. The rd_dev_write of d are applied by
+   the model from then on (e must outlive them). */
+int uub_emu_init(struct uub_emu *e,struct rd_dev *d,
+		 const struct uub_emu_config *c);
+void uub_emu_config_default(struct uub_emu_config *c);
+
+/* advance the model up to now (ns, CLOCK_MONOTONIC) */
+void uub_emu_step(struct uub_emu *e,uint64_t now);
+uint64_t uub_emu_now();
+
+/* run uub_emu_step every UUB_EMU_POLL_NS in a thread */
+int uub_emu_start(struct uub_emu *e);
+void uub_emu_stop(struct uub_emu *e);
+
+void uub_emu_print(FILE *fp,const struct uub_emu *e);
+
+/* in a reader sharing the stand-in files of d with a uub_emu process:
+   rd_dev_write waits the model to take the value */
+void uub_emu_attach(struct rd_dev *d);
+
+#endif /*_UUB_EMU_H*/
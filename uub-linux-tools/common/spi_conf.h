@@ -0,0 +1,102 @@
+/*
+ * SPI clock rate shared by the uub-linux-tools
+ *
+ * Copyright (c) 2019  Radboud Radio Lab
+ *
+ * rd_rawtrace --calibrate finds the fastest rate the housekeeping link of
+ * this board reads back without errors on its device and stores it, less a
+ * margin, in SPI_CONF_FILE ($RD_SPI_CONF if set). A tool starts at that
+ * rate only when it opens that same device; --speed still overrides it.
+ * The file holds comment lines (#) and one line per device:
+ *
+ *   speed@<device>=<Hz> [# comment]
+ */
+
+#ifndef _SPI_CONF_H
+#define _SPI_CONF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPI_CONF_FILE "/etc/rd_spi.conf"
+#define SPI_CONF_MAX_SPEED 20000000 /* housekeeping_spi_doc.txt */
+
+static inline const char *spi_conf_path(void)
+{
+	const char *path = getenv("RD_SPI_CONF");
+
+	return path && *path ? path : SPI_CONF_FILE;
+}
+
+/* the Hz of a speed@<device>= line for device; 0 if it is not one */
+static inline unsigned long spi_conf_line(const char *line, const char *device)
+{
+	size_t n = strlen(device);
+	unsigned long v;
+
+	if (strncmp(line, "speed@", 6) != 0 || strncmp(line + 6, device, n) != 0 ||
+	    line[6 + n] != '=')
+		return 0;
+	v = strtoul(line + 7 + n, NULL, 10);
+	return v <= SPI_CONF_MAX_SPEED ? v : 0;
+}
+
+/* *speed from the file for device; 0 if found, -1 if not (speed left as it is) */
+static inline int spi_conf_read(const char *device, uint32_t *speed)
+{
+	char line[384];
+	unsigned long v;
+	int ret = -1;
+	FILE *f;
+
+	f = fopen(spi_conf_path(), "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		v = spi_conf_line(line, device);
+		if (v > 0) {
+			*speed = v;
+			ret = 0;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+/*
+ * set the rate of device, keeping the lines of the other devices (written
+ * aside, then renamed); 0 if done
+ */
+static inline int spi_conf_write(const char *device, uint32_t speed,
+				 const char *comment)
+{
+	const char *path = spi_conf_path();
+	char tmp[256], line[384];
+	FILE *f, *old;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	f = fopen(tmp, "w");
+	if (!f)
+		return -1;
+	old = fopen(path, "r");
+	if (old) {
+		while (fgets(line, sizeof(line), old)) {
+			/* the old line of this device and the ones without device */
+			if (spi_conf_line(line, device) ||
+			    strncmp(line, "speed=", 6) == 0)
+				continue;
+			fputs(line, f);
+		}
+		fclose(old);
+	}
+	fprintf(f, "speed@%s=%u # %s\n", device, speed, comment);
+	if (fclose(f) != 0 || rename(tmp, path) != 0) {
+		remove(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+#endif /* _SPI_CONF_H */
@@ -22,6 +22,8 @@
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
 
+#include "../../common/spi_conf.h"
+
 #define MIN(A,B) ((A)<(B)?(A):(B))
 
 static void pabort(const char *s)
@@ -35,6 +37,7 @@ static uint32_t mode;
 static uint8_t bits = 8;
 static char *output_file;
 static uint32_t speed = 500000;
+static int speed_given;
 static uint16_t delay = 0;
 static int verbose;
 static int num_bins  = 512;
@@ -157,7 +160,7 @@ static void print_usage(const char *prog)
 {
 	printf("Usage: %s [-DsbdlHOLC3vpNR24SItT]\n", prog);
 	puts("  -D --device      device to use (default /dev/spidev1.1)\n"
-	     "  -s --speed       max speed (Hz)\n"
+	     "  -s --speed       max speed (Hz, default from " SPI_CONF_FILE ")\n"
 	     "  -d --delay       delay (usec)\n"
 	     "  -b --bpw         bits per word\n"
 	     "  -o --output      output data to a file (e.g. \"results.bin\")\n"
@@ -214,6 +217,7 @@ static void parse_opts(int argc, char *argv[])
 			break;
 		case 's':
 			speed = atoi(optarg);
+			speed_given = 1;
 			break;
 		case 'd':
 			delay = atoi(optarg);
@@ -395,6 +399,9 @@ int main(int argc, char *argv[])
 	int fd;
 
 	parse_opts(argc, argv);
+	// the rate calibrated on this device, unless --speed says otherwise
+	if (!speed_given)
+		spi_conf_read(device, &speed);
 
 	if (print_samples && bin_width > 64) {
 		pabort("Cannot decode integer larger than 64 bits");
@@ -22,6 +22,8 @@
 #include <sys/stat.h>
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
+
+#include "../../common/spi_conf.h"
 #include <sys/mman.h>
 #include <sys/stat.h>
 
@@ -61,6 +63,7 @@ static const char *device = "/dev/spidev32765.0";
 static uint32_t mode = SPI_CPHA | SPI_CPOL;
 static uint8_t bits = 8;
 static uint32_t speed = 1000000;
+static int speed_given;
 static uint16_t delay = 0;
 static bool verbose = false;
 static uint32_t chunksize = 1024;
@@ -162,7 +165,8 @@ static void print_usage(const char *prog)
 {
 	printf("Usage: %s [-Dsvcibfrguaw]\n", prog);
 	puts("  -D --device            device to use (default /dev/spidev32765.0)\n"
-	     "  -s --speed             max speed (Hz)\n"
+	     "  -s --speed             max speed (Hz, default from " SPI_CONF_FILE "\n"
+	     "                         for the device, 1 MHz to erase and program)\n"
 	     "  -v --verbose           verbose output\n"
 		 "  -c --chunksize         chunksize (for reading only, default 1024)\n"
 		 "  -i --flashid           print flash id\n"
@@ -217,6 +221,7 @@ static void parse_opts(int argc, char *argv[])
 			break;
 		case 's':
 			speed = atoi(optarg);
+			speed_given = 1;
 			break;
 		case 'c':
 			chunksize = atoi(optarg);
@@ -831,6 +836,12 @@ int main(int argc, char* argv[])
 
 
 	parse_opts(argc, argv);
+	// the rate calibrated on this device, unless --speed says otherwise;
+	// erasing and programming, which the calibration never tried, keep
+	// the default
+	if (!speed_given && !primary_input && !golden_input && !userdata_input &&
+	    !do_write_jump_addr)
+		spi_conf_read(device, &speed);
 
 	// open spi device
 	int fd = open(device, O_RDWR);
@@ -23,6 +23,8 @@
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
 
+#include "../../common/spi_conf.h"
+
 static void pabort(const char *s)
 {
 	perror(s);
@@ -33,6 +35,7 @@ static const char *device = "/dev/spidev32765.0";
 static uint32_t mode = SPI_CPHA | SPI_CPOL;
 static uint8_t bits = 8;
 static uint32_t speed = 500000;
+static int speed_given;
 static uint16_t delay = 0;
 static bool verbose = false;
 static bool loop = false;
@@ -79,7 +82,7 @@ static void print_usage(const char *prog)
 {
 	printf("Usage: %s [-Dsv]\n", prog);
 	puts("  -D --device      device to use (default /dev/spidev32765.0)\n"
-	     "  -s --speed       max speed (in Hz, default 500000)\n"
+	     "  -s --speed       max speed (in Hz, default from " SPI_CONF_FILE ", else 500000)\n"
 	     "  -v --verbose     verbose (show tx and rx buffers)\n"
          "  -V --version     print FW version\n"
          "  -o --startoffset set the offset of the trigger point from the start of the capture window\n"
@@ -116,6 +119,7 @@ static void parse_opts(int argc, char *argv[])
 			break;
 		case 's':
 			speed = atoi(optarg);
+			speed_given = 1;
 			break;
 		case 'v':
 			verbose = 1;
@@ -300,6 +304,9 @@ int main(int argc, char *argv[])
 	printf("Compiled on %s at %s\n", __DATE__, __TIME__);
 
 	parse_opts(argc, argv);
+	// the rate calibrated on this device, unless --speed says otherwise
+	if (!speed_given)
+		spi_conf_read(device, &speed);
 
 	int fd = open(device, O_RDWR);
 	if (fd < 0)
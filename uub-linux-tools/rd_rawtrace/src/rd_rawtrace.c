@@ -1,3 +1,6 @@
+/*
+ * Cross-compile with cross-gcc -I/path/to/cross-kernel/include rd_rawtrace.c rd_unpack.c
+ */
 
 #include <stdint.h>
 #include <unistd.h>
@@ -14,6 +17,11 @@
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
 
+#include "../../common/spi_conf.h"
+
+#include "rd_unpack.h"
+#include "rd_trace_file.h"
+
 
 static void pabort(const char *s)
 {
@@ -26,17 +34,39 @@ static uint32_t mode;
 static uint8_t bits = 8;
 static char *output_file;
 static uint32_t speed = 500000;
+static int speed_given;
 static uint16_t delay = 0;
 static int verbose;
 static int transfer_size;
 static bool suppress_write = false;
 static bool do_print_samples = false;
+static bool multi_segment = false;
+static int parity = -1; // xor of the 13 bits of a word, -1: not checked
+static int retries;
+static bool do_calibrate = false;
+static int margin = 20; // percent below the fastest clean rate
+static int repeat; // captures in one trace file, 0: a single raw capture
+static bool do_sw_trigger = false;
+static int wait_us = 1000;
+
+static uint64_t _read_count; // bytes clocked on the bus
+static uint64_t _write_count;
+static int _ioctl_count;
+static int _ring_pos; // read position in the capture buffer
 
 //#define CHUNKSIZE 2048
 #define CHUNKSIZE 988
 // CHUNKSIZE needs to be divisible by 52 because the vhdl module can't deal with partial sample readout
 // CHUNKSIZE needs to be less than 4095 because the maximum spi buffer size on the zynq in 4096 (and we need 1 addr byte)
 
+#define CHUNK_ALIGN 52
+#define CHUNK_MAX 4096
+// bytes in the capture buffer: 1024 entries of 4 words of 13 bits
+#define RING_SIZE (1024 * 52 / 8)
+#define SPIDEV_BUFSIZ "/sys/module/spidev/parameters/bufsiz"
+// the size field of the ioctl number is 14 bits: SPI_MSGSIZE is 0 (EINVAL)
+// unless the transfers take less than 1 << _IOC_SIZEBITS bytes
+#define MAX_SEGMENTS ((int)(((1 << _IOC_SIZEBITS) - 1) / (2 * sizeof(struct spi_ioc_transfer))))
 
 char *input_tx;
 
@@ -108,17 +138,503 @@ static void transfer(int fd, uint8_t const *tx, uint8_t const *rx, size_t len)
 	ret = ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
 	if (ret < 1)
 		pabort("can't send spi message");
-
+	_ioctl_count++;
 
 	if (verbose && rx != NULL)
 		hex_dump(rx, len, 32, "RX");
 }
 
+/*
+ * spidev refuses messages with more than bufsiz bytes to send or to receive
+ * (all transfers together), 4096 unless the module is loaded with another one
+ */
+static int spidev_bufsiz(void)
+{
+	FILE *f;
+	int n = 0;
+
+	f = fopen(SPIDEV_BUFSIZ, "r");
+	if (f) {
+		if (fscanf(f, "%d", &n) != 1)
+			n = 0;
+		fclose(f);
+	}
+	return n > 0 ? n : 4096;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Largest chunk ending on a sample boundary that fits in bufsiz with its
+ * address byte, and how many of them go in one message
+ */
+static int segment_chunk(int bufsiz, int *per_msg)
+{
+	int chunk = ((bufsiz < CHUNK_MAX ? bufsiz : CHUNK_MAX) - 1) / CHUNK_ALIGN * CHUNK_ALIGN;
+
+	if (chunk <= 0)
+		pabort("spidev bufsiz too small");
+	*per_msg = bufsiz / (chunk + 1);
+	if (*per_msg > MAX_SEGMENTS)
+		*per_msg = MAX_SEGMENTS;
+	return chunk;
+}
+
+/*
+ * Read len bytes of the capture buffer into data with as few ioctls as
+ * spidev allows: every chunk is its own transaction (address byte 0x0B,
+ * then the data) and the chunks of a message are separated by cs_change,
+ * so the capture is read back to back without returning to user space.
+ */
+static void read_segments(int fd, uint8_t *data, int len, int chunk, int per_msg)
+{
+	static const uint8_t addr = 0x0B;
+	int nchunks, i, k, ret;
+	struct spi_ioc_transfer *tr;
+	uint8_t *zero;
+
+	nchunks = (len + chunk - 1) / chunk;
+	if (per_msg > nchunks)
+		per_msg = nchunks;
+	tr = calloc(2 * per_msg, sizeof(*tr));
+	zero = calloc(chunk, 1);
+	if (!tr || !zero)
+		pabort("can't allocate the transfers");
+
+	for (i = 0; i < nchunks; i += per_msg) {
+		int n = nchunks - i < per_msg ? nchunks - i : per_msg;
+
+		memset(tr, 0, 2 * n * sizeof(*tr));
+		for (k = 0; k < n; k++) {
+			int off = (i + k) * chunk;
+			int size = len - off < chunk ? len - off : chunk;
+			struct spi_ioc_transfer *t = &tr[2 * k];
+
+			// the address byte, then zeros while the data comes in:
+			// writing a 1 would restart the capture
+			t[0].tx_buf = (unsigned long)&addr;
+			t[0].len = 1;
+			t[1].tx_buf = (unsigned long)zero;
+			t[1].rx_buf = (unsigned long)(data + off);
+			t[1].len = size;
+			// release the chip select after every chunk but the last
+			t[1].cs_change = k < n - 1;
+			t[0].speed_hz = t[1].speed_hz = speed;
+			t[0].delay_usecs = t[1].delay_usecs = delay;
+			t[0].bits_per_word = t[1].bits_per_word = bits;
+			_read_count += size + 1;
+		}
+		ret = ioctl(fd, SPI_IOC_MESSAGE(2 * n), tr);
+		if (ret < 1)
+			pabort("can't send spi message");
+		_ioctl_count++;
+	}
+	_ring_pos = (_ring_pos + len) % RING_SIZE;
+	if (verbose)
+		hex_dump(data, len, 32, "RX");
+	free(zero);
+	free(tr);
+}
+
+/* one chunk of len bytes into buf + 1 */
+static void read_chunk(int fd, uint8_t *buf, int len)
+{
+	memset(buf, 0, len + 1);
+	buf[0] = 0x0B;
+	transfer(fd, buf, buf, len + 1); // note that this overwrites the buffer
+	_read_count += len + 1;
+	_ring_pos = (_ring_pos + len) % RING_SIZE;
+}
+
+/*
+ * The capture buffer is a ring that is not written during the readout:
+ * reading on goes back to the start of the capture, so the chunk at off
+ * is read again by skipping to it.
+ */
+static void ring_seek(int fd, uint8_t *buf, int off)
+{
+	int skip = ((off - _ring_pos) % RING_SIZE + RING_SIZE) % RING_SIZE;
+
+	while (skip > 0) {
+		int n = skip < CHUNKSIZE ? skip : CHUNKSIZE;
+
+		read_chunk(fd, buf, n);
+		skip -= n;
+	}
+}
+
+/*
+ * Parity check of the len bytes of data, the chunk at off in the capture;
+ * a chunk with errors is read again, up to retries times. Returns the
+ * errors left.
+ */
+static int check_chunk(int fd, uint8_t *buf, uint8_t *data, int off, int len,
+		       uint16_t *samples, int *rereads)
+{
+	int n, err, k;
+
+	n = rd_unpack(data, len, samples);
+	err = rd_parity_errors(samples, n, parity);
+	for (k = 0; err && k < retries; k++) {
+		printf("Chunk at byte %d: %d parity errors in %d samples, reading it again\n",
+		       off, err, n);
+		ring_seek(fd, buf, off);
+		read_chunk(fd, buf, len);
+		memmove(data, buf + 1, len);
+		(*rereads)++;
+		n = rd_unpack(data, len, samples);
+		err = rd_parity_errors(samples, n, parity);
+	}
+	if (err)
+		printf("Chunk at byte %d: %d parity errors in %d samples\n", off, err, n);
+	return err;
+}
+
+static void print_samples(const uint8_t *data, int len, uint16_t *samples)
+{
+	// unpack the tightly packed 13 bit samples into the caller's buffer
+	int n = rd_unpack(data, len, samples);
+	int j;
+
+	printf("    NS     EW\n");
+	for (j=0; j<n; j++) {
+		int s = rd_sample(samples[j]);
+		if (j%2 == 0) {
+			printf("%6d", s);
+		} else {
+			printf(" %6d\n", s);
+		}
+	}
+}
+
+struct read_stats {
+	int chunks;
+	int errors;
+	int bad_chunks;
+	int rereads;
+};
+
+/*
+ * Arm the capture, trigger it and stop it, the trigger and the stop in
+ * one message so that the trigger is still in the buffer (it is
+ * overwritten after 8.192 us). Returns the time of the stop.
+ */
+static uint64_t take_capture(int fd, uint8_t *buf)
+{
+	static const uint8_t trig[] = {0x06/*subsystem*/};
+	static const uint8_t stop[] = {0x0B, 0x00};
+	struct spi_ioc_transfer tr[2];
+	struct timespec ts;
+
+	// enable writing to spi capture buffer
+	buf[0] = 0x0B; // command to active spi readout
+	buf[1] = 0x01;
+	transfer(fd, buf, NULL, 2);
+
+	// at least 8.192 us (time to fill the buffer); without --trigger
+	// this is the window for an external trigger
+	usleep(wait_us);
+
+	// disable writing to spi capture buffer
+	memset(tr, 0, sizeof(tr));
+	tr[0].tx_buf = (unsigned long)trig;
+	tr[0].len = sizeof(trig);
+	tr[0].cs_change = 1;
+	tr[1].tx_buf = (unsigned long)stop;
+	tr[1].len = sizeof(stop);
+	tr[0].speed_hz = tr[1].speed_hz = speed;
+	tr[0].delay_usecs = tr[1].delay_usecs = delay;
+	tr[0].bits_per_word = tr[1].bits_per_word = bits;
+	if (do_sw_trigger) {
+		if (ioctl(fd, SPI_IOC_MESSAGE(2), tr) < 1)
+			pabort("can't send spi message");
+	} else {
+		if (ioctl(fd, SPI_IOC_MESSAGE(1), &tr[1]) < 1)
+			pabort("can't send spi message");
+	}
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * The transfer_size bytes of the capture into data, chunk by chunk or in
+ * segments (--multi), with the parity check of every chunk. Returns the
+ * parity errors left.
+ */
+static int read_capture(int fd, uint8_t *buf, uint8_t *data, int chunk, int per_msg,
+			uint16_t *samples, struct read_stats *st)
+{
+	int num_transfers = 1 + ((transfer_size-1) / chunk); // implicit ceil
+	int errors = 0;
+	int i;
+
+	// make sure to continue writing zero's to the write_enable register
+	// otherwise data would start to be overwritten before everything is read out
+	_ring_pos = 0;
+	if (multi_segment)
+		read_segments(fd, data, transfer_size, chunk, per_msg);
+	for (i=0; i<num_transfers; i++) {
+		int len = transfer_size - i * chunk < chunk ? transfer_size - i * chunk : chunk;
+
+		if (!multi_segment) {
+			if (!repeat || verbose)
+				printf("Transferring chunk %d of %d: %d bytes\n", i, num_transfers, len);
+			read_chunk(fd, buf, len);
+			memcpy(data + i * chunk, buf + 1, len);
+		}
+		if (parity >= 0) {
+			int err = check_chunk(fd, buf, data + i * chunk, i * chunk, len,
+					      samples, &st->rereads);
+			errors += err;
+			st->bad_chunks += err > 0;
+		}
+	}
+	st->chunks += num_transfers;
+	st->errors += errors;
+	return errors;
+}
+
+/* the first sample with the extra bit (the trigger lines in top.vhd) set */
+static int find_trigger(const uint8_t *data, int len, uint16_t *samples)
+{
+	int n = rd_unpack(data, len, samples);
+	int j;
+
+	for (j = 0; j < n; j++)
+		if (rd_sample_extra(samples[j]))
+			return j;
+	return -1;
+}
+
+static void write_all(int fd, const void *p, size_t len)
+{
+	if (write(fd, p, len) != (ssize_t)len)
+		pabort("not all bytes written to output file");
+	_write_count += len;
+}
+
+/*
+ * Open the trace file for appending: the index of the traces already in
+ * it is read and dropped from the file. A file without an index (a run
+ * that did not finish) is walked trace by trace, up to the last complete
+ * one. Returns the fd, positioned at the end of the traces.
+ */
+static int open_trace_file(const char *path, uint64_t **index, uint32_t *count)
+{
+	struct rd_trace_trailer tl;
+	struct rd_trace_hdr h;
+	off_t size, pos = 0;
+	int fd;
+
+	*index = NULL;
+	*count = 0;
+	fd = open(path, O_RDWR | O_CREAT, 0666);
+	if (fd < 0)
+		pabort("could not open output file");
+	size = lseek(fd, 0, SEEK_END);
+	if (size >= (off_t)sizeof(tl) &&
+	    pread(fd, &tl, sizeof(tl), size - sizeof(tl)) == sizeof(tl) &&
+	    tl.magic == RD_INDEX_MAGIC && tl.version == RD_TRACE_VERSION &&
+	    tl.index_offset + tl.count * 8ULL + sizeof(tl) == (uint64_t)size) {
+		*count = tl.count;
+		*index = malloc(tl.count * 8ULL + 8);
+		if (!*index ||
+		    pread(fd, *index, tl.count * 8ULL, tl.index_offset) != tl.count * 8LL)
+			pabort("can't read the trace index");
+		pos = tl.index_offset;
+	} else {
+		while (pos + (off_t)sizeof(h) <= size &&
+		       pread(fd, &h, sizeof(h), pos) == sizeof(h) &&
+		       h.magic == RD_TRACE_MAGIC && pos + (off_t)sizeof(h) + h.len <= size) {
+			*index = realloc(*index, (*count + 1) * 8ULL);
+			if (!*index)
+				pabort("can't allocate the trace index");
+			(*index)[(*count)++] = pos;
+			pos += sizeof(h) + h.len;
+		}
+		if (pos == 0 && size > 0) {
+			fprintf(stderr, "%s is not a trace file\n", path);
+			exit(1);
+		}
+		if (pos < size)
+			printf("%s: no index, %u complete traces kept\n", path, *count);
+	}
+	if (ftruncate(fd, pos) || lseek(fd, pos, SEEK_SET) != pos)
+		pabort("can't truncate the output file");
+	return fd;
+}
+
+/* --repeat: captures back to back, appended to the trace file */
+static void repeat_captures(int fd, uint8_t *buf, uint8_t *data, int chunk, int per_msg,
+			   uint16_t *samples, struct read_stats *st)
+{
+	struct rd_trace_trailer tl;
+	struct rd_trace_hdr h;
+	uint64_t *index;
+	uint32_t count, first;
+	int out_fd, k;
+
+	out_fd = open_trace_file(output_file, &index, &count);
+	first = count;
+	index = realloc(index, (count + repeat) * 8ULL);
+	if (!index)
+		pabort("can't allocate the trace index");
+
+	for (k = 0; k < repeat; k++) {
+		memset(&h, 0, sizeof(h));
+		h.magic = RD_TRACE_MAGIC;
+		h.number = count;
+		h.time_ns = take_capture(fd, buf);
+		h.parity_errors = read_capture(fd, buf, data, chunk, per_msg, samples, st);
+		// with --parity the extra bit is not the trigger
+		h.trigger = parity < 0 ? find_trigger(data, transfer_size, samples) : -1;
+		h.len = transfer_size;
+		h.speed = speed;
+
+		index[count++] = lseek(out_fd, 0, SEEK_CUR);
+		write_all(out_fd, &h, sizeof(h));
+		write_all(out_fd, data, transfer_size);
+		if (verbose || h.parity_errors)
+			printf("Capture %u: trigger at sample %d, %u parity errors\n",
+			       h.number, h.trigger, h.parity_errors);
+		if (do_print_samples)
+			print_samples(data, transfer_size, samples);
+	}
+
+	memset(&tl, 0, sizeof(tl));
+	tl.magic = RD_INDEX_MAGIC;
+	tl.version = RD_TRACE_VERSION;
+	tl.count = count;
+	tl.index_offset = lseek(out_fd, 0, SEEK_CUR);
+	write_all(out_fd, index, count * 8ULL);
+	write_all(out_fd, &tl, sizeof(tl));
+	close(out_fd);
+	free(index);
+	printf("%u captures appended to %s, %u in the file\n", count - first,
+	       output_file, count);
+}
+
+/*
+ * Rates tried by --calibrate, from the old default up to the housekeeping
+ * limit; the driver takes the nearest rate the controller can make below
+ */
+static const uint32_t calib_speeds[] = {
+	500000, 1000000, 2000000, 4000000, 5000000, 8000000,
+	10000000, 12500000, 16000000, 20000000,
+};
+#define CALIB_FW_READS 64
+
+static uint8_t read_fw_version(int fd)
+{
+	uint8_t buf[] = {0x07/*subsystem*/, 0x00/*space for response*/};
+	transfer(fd, buf, buf, sizeof(buf));
+	return buf[1];
+}
+
+static void set_speed(int fd, uint32_t hz)
+{
+	speed = hz;
+	if (ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) == -1)
+		pabort("can't set max speed hz");
+}
+
+/* the whole capture buffer, from the start of the capture */
+static void read_ring(int fd, uint8_t *buf, uint8_t *ring)
+{
+	int off, n;
+
+	ring_seek(fd, buf, 0);
+	for (off = 0; off < RING_SIZE; off += n) {
+		n = RING_SIZE - off < CHUNKSIZE ? RING_SIZE - off : CHUNKSIZE;
+		read_chunk(fd, buf, n);
+		memcpy(ring + off, buf + 1, n);
+	}
+}
+
+/*
+ * Read the firmware version and the capture just taken at the slowest
+ * rate, then again at every rate of calib_speeds until something differs
+ * (or, with --parity, a sample fails). The fastest clean rate less margin
+ * percent goes to the configuration file of all the tools.
+ */
+static int calibrate(int fd, uint8_t *buf)
+{
+	uint8_t *ref = malloc(RING_SIZE), *ring = malloc(RING_SIZE);
+	uint16_t *samples = malloc(rd_unpack_count(RING_SIZE) * sizeof(*samples));
+	uint32_t best = 0;
+	uint8_t fw;
+	char comment[128];
+	unsigned int i;
+	int k, fw_err, diff, par_err, ret = 1;
+
+	if (!ref || !ring || !samples)
+		pabort("can't allocate the capture");
+
+	set_speed(fd, calib_speeds[0]);
+	fw = read_fw_version(fd);
+	read_ring(fd, buf, ref);
+	read_ring(fd, buf, ring);
+	if (memcmp(ref, ring, RING_SIZE)) {
+		printf("Calibration: the capture does not read back the same at %u Hz\n",
+		       speed);
+		goto out;
+	}
+	printf("Calibration: firmware version 0x%02X, %d bytes of capture\n",
+	       fw, RING_SIZE);
+
+	for (i = 0; i < sizeof(calib_speeds) / sizeof(calib_speeds[0]); i++) {
+		set_speed(fd, calib_speeds[i]);
+		fw_err = 0;
+		for (k = 0; k < CALIB_FW_READS; k++)
+			fw_err += read_fw_version(fd) != fw;
+		read_ring(fd, buf, ring);
+		diff = 0;
+		for (k = 0; k < RING_SIZE; k++)
+			diff += ring[k] != ref[k];
+		par_err = 0;
+		if (parity >= 0)
+			par_err = rd_parity_errors(samples, rd_unpack(ring, RING_SIZE, samples),
+						   parity);
+		printf("%9u Hz: %d of %d firmware version reads wrong, %d bytes differ, "
+		       "%d parity errors\n", speed, fw_err, CALIB_FW_READS, diff, par_err);
+		if (fw_err || diff || par_err)
+			break;
+		best = speed;
+	}
+	if (!best) {
+		printf("Calibration: no clean rate\n");
+		goto out;
+	}
+
+	speed = (uint64_t)best * (100 - margin) / 100;
+	snprintf(comment, sizeof(comment),
+		 "rd_rawtrace --calibrate: firmware 0x%02X clean up to %u Hz, margin %d%%",
+		 fw, best, margin);
+	if (spi_conf_write(device, speed, comment)) {
+		perror(spi_conf_path());
+		goto out;
+	}
+	printf("Calibration: %u Hz for %s written to %s\n", speed, device,
+	       spi_conf_path());
+	ret = 0;
+out:
+	free(samples);
+	free(ring);
+	free(ref);
+	return ret;
+}
+
 static void print_usage(const char *prog)
 {
-	printf("Usage: %s [-DsbdlHOLC3vpNR24SI]\n", prog);
+	printf("Usage: %s [-DsbdlHOLC3vpNR24SIMprcmtw]\n", prog);
 	puts("  -D --device   device to use (default /dev/spidev1.1)\n"
-	     "  -s --speed    max speed (Hz)\n"
+	     "  -s --speed    max speed (Hz, default from " SPI_CONF_FILE ")\n"
 	     "  -d --delay    delay (usec)\n"
 	     "  -b --bpw      bits per word\n"
 	     "  -o --output   output data to a file (e.g. \"results.bin\")\n"
@@ -131,7 +647,17 @@ static void print_usage(const char *prog)
 	     "  -N --no-cs    no chip select\n"
 	     "  -S --size     transfer size\n"
 	     "  -n --no-write suppress spi transactions that force a write period\n"
-		 "  -P --do-print also print the sample values as ascii to stdout\n");
+		 "  -P --do-print also print the sample values as ascii to stdout\n"
+	     "  -M --multi    read several chunks per spi message (chunks sized from spidev bufsiz);\n"
+	     "                needs spidev loaded with a larger bufsiz than the default 4096\n"
+	     "                (e.g. spidev.bufsiz=65536), else it is one chunk per message\n"
+	     "  -p --parity   check the parity of every sample: even or odd (xor of the 13 bits)\n"
+	     "  -r --retries  read a chunk with parity errors again, up to this many times\n"
+	     "  -c --calibrate find the fastest clean spi rate and store it for all the tools\n"
+	     "  -m --margin   percent below the fastest clean rate to store (default 20)\n"
+	     "  -R --repeat   take this many captures, appended to the output as a trace file\n"
+	     "  -t --trigger  inject a firmware trigger at the end of each capture\n"
+	     "  -w --wait     capture window before the stop (usec, default 1000)\n");
 	exit(1);
 }
 
@@ -154,11 +680,19 @@ static void parse_opts(int argc, char *argv[])
 			{ "size",    1, 0, 'S' },
 			{ "no-write",0, 0, 'n' },
 			{ "do-print",0, 0, 'P' },
+			{ "multi",   0, 0, 'M' },
+			{ "parity",  1, 0, 'p' },
+			{ "retries", 1, 0, 'r' },
+			{ "calibrate", 0, 0, 'c' },
+			{ "margin",  1, 0, 'm' },
+			{ "repeat",  1, 0, 'R' },
+			{ "trigger", 0, 0, 't' },
+			{ "wait",    1, 0, 'w' },
 			{ NULL, 0, 0, 0 },
 		};
 		int c;
 
-		c = getopt_long(argc, argv, "D:s:d:b:o:HOLC3NvS:nP",
+		c = getopt_long(argc, argv, "D:s:d:b:o:HOLC3NvS:nPMp:r:cm:R:tw:",
 				lopts, NULL);
 
 		if (c == -1)
@@ -170,6 +704,7 @@ static void parse_opts(int argc, char *argv[])
 			break;
 		case 's':
 			speed = atoi(optarg);
+			speed_given = 1;
 			break;
 		case 'd':
 			delay = atoi(optarg);
@@ -210,6 +745,37 @@ static void parse_opts(int argc, char *argv[])
 		case 'P':
 			do_print_samples = true;
 			break;
+		case 'M':
+			multi_segment = true;
+			break;
+		case 'p':
+			if (!strcmp(optarg, "even"))
+				parity = 0;
+			else if (!strcmp(optarg, "odd"))
+				parity = 1;
+			else
+				print_usage(argv[0]);
+			break;
+		case 'r':
+			retries = atoi(optarg);
+			break;
+		case 'c':
+			do_calibrate = true;
+			break;
+		case 'm':
+			margin = atoi(optarg);
+			if (margin < 0 || margin > 90)
+				print_usage(argv[0]);
+			break;
+		case 'R':
+			repeat = atoi(optarg);
+			break;
+		case 't':
+			do_sw_trigger = true;
+			break;
+		case 'w':
+			wait_us = atoi(optarg);
+			break;
 		default:
 			print_usage(argv[0]);
 			break;
@@ -223,10 +789,6 @@ static void parse_opts(int argc, char *argv[])
 	}
 }
 
-static uint64_t _read_count;
-static uint64_t _write_count;
-
-
 int main(int argc, char *argv[])
 {
 	printf("This is rd_rawtrace\n(c)Radboud Radio Lab\nAuthor: Sjoerd T. Timmer (s.timmer@astro.ru.nl)\n");
@@ -236,6 +798,9 @@ int main(int argc, char *argv[])
 	int fd;
 
 	parse_opts(argc, argv);
+	// the rate calibrated on this device, unless --speed says otherwise
+	if (!speed_given)
+		spi_conf_read(device, &speed);
 
 	fd = open(device, O_RDWR);
 	if (fd < 0)
@@ -278,80 +843,83 @@ int main(int argc, char *argv[])
 	printf("bits per word: %d\n", bits);
 	printf("max speed: %d Hz (%d KHz)\n", speed, speed/1000);
 
-	int out_fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-	if (out_fd < 0)
-		pabort("could not open output file");
-
-	uint8_t * buf = (uint8_t*)malloc(CHUNKSIZE + 1);
-
-	if (!suppress_write)
-	{
-		// enable writing to spi capture buffer
-		buf[0] = 0x0B; // command to active spi readout
-		buf[1] = 0x01;
-		transfer(fd, buf, NULL, 2);
-
-		// not strictly needed because transactions should take more than enough time to fill our buffer
-		 usleep(1000); // sleep at least 8.192 us (time to fill the buffer)
-
-		// disable writing to spi capture buffer
-		buf[0] = 0x0B; // command to active spi readout
-		buf[1] = 0x00;
-		transfer(fd, buf, NULL, 2);
+	int chunk = CHUNKSIZE, per_msg = 1;
+	if (multi_segment) {
+		int bufsiz = spidev_bufsiz();
+		chunk = segment_chunk(bufsiz, &per_msg);
+		printf("spidev bufsiz %d: chunks of %d bytes, %d per message\n",
+		       bufsiz, chunk, per_msg);
+		if (per_msg < 2)
+			printf("Warning: one chunk per message, --multi does not help; load spidev\n"
+			       "with bufsiz=%d or more for two chunks per message\n",
+			       2 * ((CHUNK_MAX - 1) / CHUNK_ALIGN * CHUNK_ALIGN + 1));
+	}
+	if (retries > 0 && (parity < 0 || transfer_size % CHUNK_ALIGN)) {
+		// a partial word does not move the read pointer: no way back to the chunk
+		printf("Re-reading needs --parity and a size multiple of %d bytes\n", CHUNK_ALIGN);
+		retries = 0;
 	}
 
-	// do the actual transfer: make sure to continue writing zero's to the write_enable register
-	// otherwise data would start to be overwritten before everything is read out:
-	int num_transfers = 1 + ((transfer_size-1) / CHUNKSIZE); // implicit ceil
-	int i;
-	for (i=0; i<num_transfers; i++) {
-		int chunksize = CHUNKSIZE;
-		if (transfer_size - i * CHUNKSIZE < chunksize) chunksize = transfer_size - i * CHUNKSIZE;
-		printf("Transferring chunk %d of %d: %d bytes\n", i, num_transfers, chunksize);
-
-		memset(buf, 0, CHUNKSIZE + 1);
-		buf[0] = 0x0B;
-		transfer(fd, buf, buf, chunksize+1); // note that this overwrites the buffer
-
-		int ret = write(out_fd, buf + 1, chunksize);
-		if (ret != chunksize)
-			pabort("not all bytes written to output file");
-
-		// unpack the tightly packed 13 bit samples into integers
-		int samples_in_chunk = chunksize * 8 / 13;
-		// the shifts are a bit hard to calculate, but fortunately they repeat every 8 samples
-		int shifts[8] = {11, 6, 9, 4, 7, 10, 5, 8};
-		int * samples = malloc(samples_in_chunk * sizeof(int));
-		int j;
-		for (j=0; j<samples_in_chunk; j++) {
-			int start_bit  = 13 * j;
-			int start_byte = start_bit / 8;
-			int x1 = buf[1 + start_byte + 0];
-			int x2 = buf[1 + start_byte + 1];
-			int x3 = buf[1 + start_byte + 2];
-			int shift = shifts[j % 8];
-			int mask  = 0x0FFF;
-			int s = (((x1 << 16) + (x2 << 8) + x3) >> shift) & mask;
-			samples[j] = s;
-			//printf("decoding bytes %d-%d");
-		}
-
-		// print
-		if (do_print_samples) {
-			printf("    NS     EW\n");
-			for (j=0; j<samples_in_chunk; j++) {
-				int s = samples[j] > 2047 ? samples[j] - 4096 : samples[j];
-				if (j%2 == 0) {
-					printf("%6d", s);
-				} else {
-					printf(" %6d\n", s);
-				}
+	uint8_t * buf = (uint8_t*)malloc((chunk > CHUNKSIZE ? chunk : CHUNKSIZE) + 1);
+	uint16_t * samples = malloc(rd_unpack_count(transfer_size > chunk ?
+						    transfer_size : chunk) * sizeof(*samples));
+	if (!buf || !samples)
+		pabort("can't allocate the buffers");
+
+	if (!suppress_write && !repeat)
+		take_capture(fd, buf);
+
+	if (do_calibrate) {
+		_ring_pos = 0;
+		ret = calibrate(fd, buf);
+		free(samples);
+		free(buf);
+		close(fd);
+		return ret;
+	}
 
-			}
-		}
+	uint8_t *data = malloc(transfer_size);
+	if (!data)
+		pabort("can't allocate the capture");
+	struct read_stats st = { 0 };
+	_ioctl_count = 0;
+	double t0 = now();
+
+	if (repeat) {
+		repeat_captures(fd, buf, data, chunk, per_msg, samples, &st);
+		t0 = now() - t0;
+		printf("%d captures in %.3f s: %.1f captures/s\n", repeat, t0, repeat / t0);
+	} else {
+		int out_fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (out_fd < 0)
+			pabort("could not open output file");
+
+		read_capture(fd, buf, data, chunk, per_msg, samples, &st);
+		t0 = now() - t0;
+
+		write_all(out_fd, data, transfer_size);
+		if (do_print_samples)
+			print_samples(data, transfer_size, samples);
+		close(out_fd);
+
+		// the link can't do better than one byte every 8 clocks
+		printf("Read %d bytes (%llu on the bus) in %d ioctl(s), %.3f ms: "
+		       "%.0f bytes/s of %.0f bytes/s (%.1f%%)\n",
+		       transfer_size, (unsigned long long)_read_count, _ioctl_count,
+		       t0 * 1e3, _read_count / t0, speed / 8.0,
+		       100.0 * _read_count / t0 / (speed / 8.0));
+	}
+	ret = 0;
+	if (parity >= 0) {
+		printf("Parity: %d errors in %d of %d chunks, %d chunks read again\n",
+		       st.errors, st.bad_chunks, st.chunks, st.rereads);
+		if (st.errors)
+			ret = 2;
 	}
 
-	close(out_fd);
+	free(data);
+	free(samples);
+	free(buf);
 
 	close(fd);
 
@@ -0,0 +1,46 @@
+/*
+ * File of captures written by rd_rawtrace --repeat
+ *
+ * Copyright (c) 2019  Radboud Radio Lab
+ *
+ * Layout (little endian):
+ *
+ *   trace 0: struct rd_trace_hdr, then len bytes as read from spi_capture
+ *   trace 1: ...
+ *   index:   uint64_t offset[count] of each trace header in the file
+ *   struct rd_trace_trailer (the last 24 bytes of the file)
+ *
+ * A reader seeks to the end - sizeof(struct rd_trace_trailer), then to
+ * index_offset, and from there straight to any trace. A new run on the
+ * same file drops the index, appends its traces and writes the index of
+ * all of them.
+ */
+
+#ifndef _RD_TRACE_FILE_H
+#define _RD_TRACE_FILE_H
+
+#include <stdint.h>
+
+#define RD_TRACE_MAGIC   0x52545452 /* "RTTR" */
+#define RD_INDEX_MAGIC   0x58444952 /* "RIDX" */
+#define RD_TRACE_VERSION 1
+
+struct rd_trace_hdr {
+	uint32_t magic;
+	uint32_t number;        /* of the trace in the file, from 0 */
+	uint64_t time_ns;       /* CLOCK_REALTIME at the end of the capture */
+	int32_t  trigger;       /* first sample with the extra bit set, -1: none */
+	uint32_t parity_errors; /* left after re-reads, 0 if not checked */
+	uint32_t len;           /* bytes of capture that follow */
+	uint32_t speed;         /* spi clock of the readout (Hz) */
+} __attribute__((packed));
+
+struct rd_trace_trailer {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;         /* traces in the file */
+	uint32_t reserved;
+	uint64_t index_offset;  /* of offset[0] */
+} __attribute__((packed));
+
+#endif /* _RD_TRACE_FILE_H */
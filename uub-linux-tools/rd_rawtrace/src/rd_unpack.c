@@ -0,0 +1,148 @@
+/*
+ * Decoder for the samples of the spi_capture buffer (rd_rawtrace)
+ *
+ * Copyright (c) 2019  Radboud Radio Lab
+ */
+
+#include <string.h>
+
+/*
+ * The NEON decoder is only built on request (-DRD_UNPACK_USE_NEON) until it
+ * has been checked with rd_unpack_bench on the UUB
+ */
+#if defined(RD_UNPACK_USE_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define RD_UNPACK_NEON
+#endif
+
+#include "rd_unpack.h"
+
+#define MASK13 0x1FFF
+
+static inline uint64_t load_be64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, 8);
+	return __builtin_bswap64(v); /* little endian on the UUB and on x86 */
+}
+
+/*
+ * One group: bytes 0-7 hold words 0-3 (bits 0-51), bytes 5-12 hold words
+ * 4-7 (bits 52-103 of the group, 12-63 of the load)
+ */
+static inline void unpack_group(const uint8_t *src, uint16_t *dst)
+{
+	uint64_t a = load_be64(src);
+	uint64_t b = load_be64(src + 5);
+
+	dst[0] = (a >> 51) & MASK13;
+	dst[1] = (a >> 38) & MASK13;
+	dst[2] = (a >> 25) & MASK13;
+	dst[3] = (a >> 12) & MASK13;
+	dst[4] = (b >> 39) & MASK13;
+	dst[5] = (b >> 26) & MASK13;
+	dst[6] = (b >> 13) & MASK13;
+	dst[7] = b & MASK13;
+}
+
+#ifdef RD_UNPACK_NEON
+/*
+ * Each word in a 32 bit lane: the 3 bytes it spans, first byte highest
+ * (index 255 gives 0), then shifted down by the number of bits after it
+ */
+static const uint8_t neon_index[32] = {
+	2, 1, 0, 255,    3, 2, 1, 255,    5, 4, 3, 255,    6, 5, 4, 255,
+	8, 7, 6, 255,   10, 9, 8, 255,   11, 10, 9, 255,  255, 12, 11, 255,
+};
+static const int32_t neon_shift[8] = { -11, -6, -9, -4, -7, -10, -5, -8 };
+
+/* groups while 16 bytes can be loaded; returns the bytes decoded */
+static size_t unpack_neon(const uint8_t *src, size_t len, uint16_t *dst)
+{
+	const uint8x8_t i0 = vld1_u8(neon_index);
+	const uint8x8_t i1 = vld1_u8(neon_index + 8);
+	const uint8x8_t i2 = vld1_u8(neon_index + 16);
+	const uint8x8_t i3 = vld1_u8(neon_index + 24);
+	const int32x4_t s0 = vld1q_s32(neon_shift);
+	const int32x4_t s1 = vld1q_s32(neon_shift + 4);
+	const uint32x4_t mask = vdupq_n_u32(MASK13);
+	uint8x8x2_t in;
+	uint32x4_t lo, hi;
+	size_t pos;
+
+	for (pos = 0; pos + 16 <= len; pos += RD_GROUP_BYTES) {
+		in.val[0] = vld1_u8(src + pos);
+		in.val[1] = vld1_u8(src + pos + 8);
+		lo = vreinterpretq_u32_u8(vcombine_u8(vtbl2_u8(in, i0),
+						      vtbl2_u8(in, i1)));
+		hi = vreinterpretq_u32_u8(vcombine_u8(vtbl2_u8(in, i2),
+						      vtbl2_u8(in, i3)));
+		lo = vandq_u32(vshlq_u32(lo, s0), mask);
+		hi = vandq_u32(vshlq_u32(hi, s1), mask);
+		vst1q_u16(dst, vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+		dst += RD_GROUP_SAMPLES;
+	}
+	return pos;
+}
+#endif
+
+size_t rd_unpack(const uint8_t *src, size_t len, uint16_t *dst)
+{
+	uint8_t tail[16];
+	uint16_t words[RD_GROUP_SAMPLES];
+	size_t n = rd_unpack_count(len);
+	size_t pos = 0;
+
+#ifdef RD_UNPACK_NEON
+	pos = unpack_neon(src, len, dst);
+	dst += pos / RD_GROUP_BYTES * RD_GROUP_SAMPLES;
+#endif
+	for (; pos + RD_GROUP_BYTES <= len; pos += RD_GROUP_BYTES) {
+		unpack_group(src + pos, dst);
+		dst += RD_GROUP_SAMPLES;
+	}
+
+	/* an incomplete group: decoded from a zero padded copy */
+	if (pos < len) {
+		memset(tail, 0, sizeof(tail));
+		memcpy(tail, src + pos, len - pos);
+		unpack_group(tail, words);
+		memcpy(dst, words, rd_unpack_count(len - pos) * sizeof(*dst));
+	}
+	return n;
+}
+
+size_t rd_parity_errors(const uint16_t *w, size_t n, int parity)
+{
+	size_t i, err = 0;
+
+	for (i = 0; i < n; i++)
+		err += __builtin_parity(w[i] & MASK13) ^ parity;
+	return err;
+}
+
+size_t rd_pack(const uint16_t *src, size_t n, uint8_t *dst)
+{
+	size_t len = rd_pack_size(n);
+	size_t i, bit = 0;
+	int b;
+
+	memset(dst, 0, len);
+	for (i = 0; i < n; i++) {
+		for (b = 12; b >= 0; b--, bit++) {
+			if (src[i] & (1 << b))
+				dst[bit / 8] |= 0x80 >> (bit % 8);
+		}
+	}
+	return len;
+}
+
+const char *rd_unpack_impl(void)
+{
+#ifdef RD_UNPACK_NEON
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
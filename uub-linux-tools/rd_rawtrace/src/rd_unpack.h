@@ -0,0 +1,68 @@
+/*
+ * Decoder for the samples of the spi_capture buffer (rd_rawtrace)
+ *
+ * Copyright (c) 2019  Radboud Radio Lab
+ *
+ * spi_capture sends its buffer as a bit stream, most significant bit first,
+ * of 13 bit words: one extra bit (i_data_extra) followed by a 12 bit two's
+ * complement sample. Each buffer entry holds 4 words (NS even, EW even,
+ * NS odd, EW odd), so 8 words make up exactly 13 bytes: the decoder works
+ * on such groups, without branches per sample.
+ *
+ * The words are returned with all 13 bits, the extra bit in bit 12; use
+ * rd_sample() and rd_sample_extra() to split them.
+ */
+
+#ifndef _RD_UNPACK_H
+#define _RD_UNPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RD_GROUP_BYTES   13
+#define RD_GROUP_SAMPLES 8
+
+/* number of complete words in len bytes */
+static inline size_t rd_unpack_count(size_t len)
+{
+	return len * 8 / 13;
+}
+
+/* bytes taken by n words */
+static inline size_t rd_pack_size(size_t n)
+{
+	return (n * 13 + 7) / 8;
+}
+
+static inline int rd_sample(uint16_t w)
+{
+	return (int16_t)(w << 4) >> 4;
+}
+
+static inline int rd_sample_extra(uint16_t w)
+{
+	return (w >> 12) & 1;
+}
+
+/*
+ * Decode the rd_unpack_count(len) words of src into dst (the caller's
+ * buffer, room for that many words); returns the number of words
+ */
+size_t rd_unpack(const uint8_t *src, size_t len, uint16_t *dst);
+
+/*
+ * Number of the n words whose 13 bits do not xor to parity (0: even,
+ * 1: odd), when the extra bit is a parity bit
+ */
+size_t rd_parity_errors(const uint16_t *w, size_t n, int parity);
+
+/*
+ * Reference encoder, one bit at a time: the low 13 bits of the n words of
+ * src into rd_pack_size(n) bytes of dst; returns that size
+ */
+size_t rd_pack(const uint16_t *src, size_t n, uint8_t *dst);
+
+/* the decoder in use: "neon" (built with -DRD_UNPACK_USE_NEON) or "scalar" */
+const char *rd_unpack_impl(void);
+
+#endif /* _RD_UNPACK_H */
@@ -0,0 +1,164 @@
+/*
+ * Round trip test and speed of the spi_capture decoder (rd_unpack.h)
+ *
+ * Copyright (c) 2019  Radboud Radio Lab
+ *
+ * Random words are packed with the reference encoder and must come back
+ * from rd_unpack() for every length and alignment, and agree with the
+ * original rd_rawtrace decoder. With -f a capture written by
+ * rd_rawtrace -o is decoded and packed again.
+ *
+ *   rd_unpack_bench [-n iterations] [-f capture.bin]
+ *
+ * Build: cc -O2 rd_unpack_bench.c rd_unpack.c -o rd_unpack_bench
+ * (add -DRD_UNPACK_USE_NEON -mfpu=neon on the UUB to test the NEON decoder)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "rd_unpack.h"
+
+#define NWORDS 16384 /* 8192 buffer entries of 52 bits */
+#define NBYTES (NWORDS * 13 / 8)
+
+static uint16_t words[NWORDS];
+static uint16_t check[NWORDS];
+static int legacy[NWORDS];
+static uint8_t packed[NBYTES + 16];
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* the decoder rd_rawtrace used before rd_unpack: 12 bits, no extra bit */
+static void unpack_legacy(const uint8_t *buf, int len, int *samples)
+{
+	int shifts[8] = {11, 6, 9, 4, 7, 10, 5, 8};
+	int n = len * 8 / 13;
+	int j;
+
+	for (j = 0; j < n; j++) {
+		int start_byte = 13 * j / 8;
+		int x1 = buf[start_byte + 0];
+		int x2 = buf[start_byte + 1];
+		int x3 = buf[start_byte + 2];
+
+		samples[j] = (((x1 << 16) + (x2 << 8) + x3) >> shifts[j % 8]) & 0x0FFF;
+	}
+}
+
+static int round_trip(void)
+{
+	size_t n, len, i;
+	int off;
+
+	for (i = 0; i < NWORDS; i++)
+		words[i] = rand() & 0x1FFF;
+
+	for (off = 0; off < 4; off++) {
+		for (n = 0; n < 300; n++) {
+			memset(packed, 0xA5, sizeof(packed));
+			len = rd_pack(words, n, packed + off);
+			memset(check, 0, n * sizeof(*check));
+			if (rd_unpack(packed + off, len, check) != n ||
+			    memcmp(check, words, n * sizeof(*check)) != 0) {
+				printf("round trip failed: %zu words at offset %d\n",
+				       n, off);
+				return 1;
+			}
+		}
+	}
+
+	len = rd_pack(words, NWORDS, packed);
+	rd_unpack(packed, len, check);
+	unpack_legacy(packed, len, legacy);
+	for (i = 0; i < NWORDS; i++) {
+		if (check[i] != words[i] || (check[i] & 0x0FFF) != legacy[i]) {
+			printf("word %zu: %04X, got %04X, old decoder %03X\n",
+			       i, words[i], check[i], legacy[i]);
+			return 1;
+		}
+	}
+	printf("round trip (%s): ok\n", rd_unpack_impl());
+	return 0;
+}
+
+static int capture(const char *path)
+{
+	static uint8_t data[NBYTES], again[NBYTES];
+	FILE *f;
+	size_t len, n;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+	len = fread(data, 1, sizeof(data), f);
+	fclose(f);
+	len -= len % RD_GROUP_BYTES;
+	n = rd_unpack(data, len, check);
+	rd_pack(check, n, again);
+	if (memcmp(data, again, len) != 0) {
+		printf("%s: does not pack back to the same bytes\n", path);
+		return 1;
+	}
+	printf("%s: %zu words ok\n", path, n);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = NULL;
+	int niter = 1000;
+	double t0, t_new, t_old;
+	int i, c;
+
+	while ((c = getopt(argc, argv, "n:f:")) != -1) {
+		switch (c) {
+		case 'n':
+			niter = atoi(optarg);
+			break;
+		case 'f':
+			path = optarg;
+			break;
+		default:
+			printf("Usage: %s [-n iterations] [-f capture.bin]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (niter < 1)
+		niter = 1;
+
+	srand(1);
+	if (round_trip())
+		return 1;
+	if (path && capture(path))
+		return 1;
+
+	rd_pack(words, NWORDS, packed);
+	t0 = now();
+	for (i = 0; i < niter; i++)
+		rd_unpack(packed, NBYTES, check);
+	t_new = (now() - t0) / niter;
+	t0 = now();
+	for (i = 0; i < niter; i++)
+		unpack_legacy(packed, NBYTES, legacy);
+	t_old = (now() - t0) / niter;
+
+	printf("%d words (%d bytes)\n", NWORDS, NBYTES);
+	printf("rd_unpack (%-6s): %8.2f us %8.1f Msamples/s\n", rd_unpack_impl(),
+	       t_new * 1e6, NWORDS / t_new * 1e-6);
+	printf("old decoder       : %8.2f us %8.1f Msamples/s\n",
+	       t_old * 1e6, NWORDS / t_old * 1e-6);
+	return 0;
+}
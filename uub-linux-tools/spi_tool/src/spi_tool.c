@@ -22,6 +22,8 @@
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
 
+#include "../../common/spi_conf.h"
+
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
 static void pabort(const char *s)
@@ -36,6 +38,7 @@ static uint8_t bits = 8;
 static char *input_file;
 static char *output_file;
 static uint32_t speed = 500000;
+static int speed_given;
 static uint16_t delay;
 static int verbose;
 static int transfer_size;
@@ -165,7 +168,7 @@ static void print_usage(const char *prog)
 {
 	printf("Usage: %s [-DsbdlHOLC3vpNR24SI]\n", prog);
 	puts("  -D --device   device to use (default /dev/spidev1.1)\n"
-	     "  -s --speed    max speed (Hz)\n"
+	     "  -s --speed    max speed (Hz, default from " SPI_CONF_FILE ")\n"
 	     "  -d --delay    delay (usec)\n"
 	     "  -b --bpw      bits per word\n"
 	     "  -i --input    input data from a file (e.g. \"test.bin\")\n"
@@ -226,6 +229,7 @@ static void parse_opts(int argc, char *argv[])
 			break;
 		case 's':
 			speed = atoi(optarg);
+			speed_given = 1;
 			break;
 		case 'd':
 			delay = atoi(optarg);
@@ -411,6 +415,9 @@ int main(int argc, char *argv[])
 	int fd;
 
 	parse_opts(argc, argv);
+	// the rate calibrated on this device, unless --speed says otherwise
+	if (!speed_given)
+		spi_conf_read(device, &speed);
 
 	fd = open(device, O_RDWR);
 	if (fd < 0)